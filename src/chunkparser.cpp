@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "chunkparser.hpp"
+
+// chunks are not made smaller than this, starting threads for tiny chunks does not pay off
+const size_t MIN_CHUNK_SIZE = 1 << 18;
+
+enum section_type {SECTION_OBJECTS, SECTION_INIT};
+
+struct problem_section{
+	section_type type;
+	char* begin; // the opening parenthesis
+	char* body;  // just after the keyword
+	char* end;   // just after the closing parenthesis
+};
+
+struct section_chunk{
+	section_type type;
+	const char* begin;
+	const char* end;
+	bool whole_section;
+	bool ok = true;
+
+	// contents of :init
+	fact_store facts;
+	vector<pair<ground_literal,int>> functions;
+	// contents of :objects, pointing into the scanned text
+	vector<pair<vector<string_view>,string_view>> typed_objects;
+	vector<string_view> untyped_objects;
+};
+
+enum chunk_token {TOKEN_OPEN, TOKEN_CLOSE, TOKEN_EQUAL, TOKEN_DASH, TOKEN_NOT, TOKEN_NAME, TOKEN_INT, TOKEN_END, TOKEN_OTHER};
+
+// keywords of the scanner that may look like names. If they occur, the section is left to the bison parser
+const char* name_keywords[] = {"define", "domain", "problem", "minimize", "and", "or", "imply", "forall", "exists", "when", "increase", "typeof", "sortof"};
+
+bool is_name_start(char c){ return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+bool is_name_char(char c){ return is_name_start(c) || (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '|'; }
+bool is_digit(char c){ return c >= '0' && c <= '9'; }
+bool is_space(char c){ return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+// skips a comment starting at pos. Returns NULL if it is not terminated by a line break (the scanner would not treat it as a comment)
+const char* skip_comment(const char* pos, const char* end){
+	const char* nl = (const char*) memchr(pos, '\n', end - pos);
+	return nl ? nl + 1 : NULL;
+}
+
+// the tokens of the scanner that can occur in plain :init and :objects sections
+struct chunk_scanner{
+	const char* pos;
+	const char* end;
+	const char* text;
+	size_t len;
+
+	chunk_scanner(const char* b, const char* e) : pos(b), end(e) {}
+
+	chunk_token next(){
+		while (pos < end){
+			if (is_space(*pos)) pos++;
+			else if (*pos == ';'){
+				pos = skip_comment(pos, end);
+				if (!pos) { pos = end; return TOKEN_OTHER; }
+			} else break;
+		}
+		if (pos == end) return TOKEN_END;
+
+		text = pos;
+		char c = *pos++;
+		if (c == '(') return TOKEN_OPEN;
+		if (c == ')') return TOKEN_CLOSE;
+		if (c == '=') return TOKEN_EQUAL;
+		if (c == '-') return TOKEN_DASH;
+		if (is_digit(c)){
+			while (pos < end && is_digit(*pos)) pos++;
+			len = pos - text;
+			// a float
+			if (pos + 1 < end && *pos == '.' && is_digit(pos[1])) return TOKEN_OTHER;
+			return TOKEN_INT;
+		}
+		if (is_name_start(c)){
+			while (pos < end && is_name_char(*pos)) pos++;
+			len = pos - text;
+			if (len == 3 && strncmp(text, "not", 3) == 0) return TOKEN_NOT;
+			for (const char* k : name_keywords)
+				if (strlen(k) == len && strncmp(text, k, len) == 0) return TOKEN_OTHER;
+			return TOKEN_NAME;
+		}
+		return TOKEN_OTHER;
+	}
+
+	string name(){ return string(text, len); }
+	string_view view(){ return string_view(text, len); }
+};
+
+enum init_element {INIT_FACT, INIT_NEGATIVE_FACT, INIT_FUNCTION, INIT_END, INIT_INVALID};
+
+// reads the arguments of an atom up to and including the closing parenthesis. All arguments have to be constants
+bool read_atom_arguments(chunk_scanner & s, vector<string_view> & args){
+	args.clear();
+	while (true){
+		chunk_token t = s.next();
+		if (t == TOKEN_CLOSE) return true;
+		if (t != TOKEN_NAME) return false;
+		args.push_back(s.view());
+	}
+}
+
+// reads '(' NAME arguments ')'
+bool read_atom(chunk_scanner & s, string_view & predicate, vector<string_view> & args){
+	if (s.next() != TOKEN_OPEN || s.next() != TOKEN_NAME) return false;
+	predicate = s.view();
+	return read_atom_arguments(s, args);
+}
+
+// reads the next fact, negated fact, or function value of an :init section. The names point into the scanned text
+init_element read_init_element(chunk_scanner & s, string_view & predicate, vector<string_view> & args, int & value){
+	chunk_token t = s.next();
+	if (t == TOKEN_END) return INIT_END;
+	if (t != TOKEN_OPEN) return INIT_INVALID;
+
+	t = s.next();
+	if (t == TOKEN_NAME){
+		predicate = s.view();
+		return read_atom_arguments(s, args) ? INIT_FACT : INIT_INVALID;
+	} else if (t == TOKEN_NOT){
+		if (!read_atom(s, predicate, args) || s.next() != TOKEN_CLOSE) return INIT_INVALID;
+		return INIT_NEGATIVE_FACT;
+	} else if (t == TOKEN_EQUAL){
+		if (!read_atom(s, predicate, args) || s.next() != TOKEN_INT) return INIT_INVALID;
+		value = atoi(s.name().c_str());
+		return s.next() == TOKEN_CLOSE ? INIT_FUNCTION : INIT_INVALID;
+	}
+	return INIT_INVALID;
+}
+
+void parse_init_chunk(section_chunk & c){
+	chunk_scanner s(c.begin, c.end);
+	string_view predicate;
+	vector<string_view> args;
+	vector<int> ids;
+	int value;
+	// names are looked up by their text in the file, a string is only built for the first occurrence of a name in the chunk
+	unordered_map<string_view,int> constant_ids;
+	unordered_map<string_view,predicate_facts*> predicates;
+	while (true){
+		init_element e = read_init_element(s, predicate, args, value);
+		if (e == INIT_END) return;
+		if (e == INIT_INVALID) { c.ok = false; return; }
+
+		// negative facts are ignored, but their constants are declared nevertheless
+		ids.clear();
+		for (string_view a : args){
+			auto it = constant_ids.find(a);
+			if (it == constant_ids.end()) it = constant_ids.emplace(a, c.facts.constant_id(string(a))).first;
+			ids.push_back(it->second);
+		}
+		if (e == INIT_FACT){
+			auto it = predicates.find(predicate);
+			if (it == predicates.end()) it = predicates.emplace(predicate, &c.facts.predicates[string(predicate)]).first;
+			it->second->add(true, ids);
+		} else if (e == INIT_FUNCTION){
+			ground_literal l;
+			l.positive = true;
+			l.predicate = predicate;
+			for (string_view a : args) l.args.push_back(string(a));
+			c.functions.push_back(make_pair(l, value));
+		}
+	}
+}
+
+void parse_objects_chunk(section_chunk & c){
+	chunk_scanner s(c.begin, c.end);
+	vector<string_view> names;
+	while (true){
+		chunk_token t = s.next();
+		if (t == TOKEN_NAME) names.push_back(s.view());
+		else if (t == TOKEN_DASH){
+			if (names.size() == 0 || s.next() != TOKEN_NAME) { c.ok = false; return; }
+			c.typed_objects.push_back(make_pair(move(names), s.view()));
+			names.clear();
+		} else if (t == TOKEN_END) break;
+		else { c.ok = false; return; }
+	}
+	// untyped objects may only be declared if no object in the section has a type
+	if (names.size()){
+		if (!c.whole_section || c.typed_objects.size()) c.ok = false;
+		else c.untyped_objects = move(names);
+	}
+}
+
+// Scanning a memory-mapped file makes its pages resident. For sections that are read only once, the pages behind the scanner are given back, s.t. the memory used does not grow with the size of the file
+struct page_releaser{
+	// pages are given back in steps of this size
+	static const size_t STEP = 1 << 20;
+	bool active;
+	uintptr_t released; // first page that has not been released
+
+	page_releaser(const char* begin, bool mapped) : active(mapped), released(0) {
+#ifndef _WIN32
+		size_t page_size = sysconf(_SC_PAGESIZE);
+		released = ((uintptr_t) begin + page_size - 1) / page_size * page_size;
+#endif
+	}
+
+	void advance(const char* pos){
+#ifndef _WIN32
+		// stay a step behind, the current element may start on the pages before pos
+		if (!active || (uintptr_t) pos < released + 2 * STEP) return;
+		madvise((void*) released, STEP, MADV_DONTNEED);
+		released += STEP;
+#endif
+	}
+};
+
+// finds the :objects and :init sections among the top level elements of the problem definition
+bool find_sections(char* data, size_t size, vector<problem_section> & sections, page_releaser pages = page_releaser(NULL, false)){
+	char* end = data + size;
+	int depth = 0;
+	problem_section current;
+	current.begin = NULL;
+	for (char* pos = data; pos < end; pos++){
+		if ((pos - data) % page_releaser::STEP == 0) pages.advance(pos);
+		char c = *pos;
+		if (c == ';'){
+			const char* next = skip_comment(pos, end);
+			if (!next) return false;
+			pos = (char*) next - 1;
+		} else if (c == '('){
+			depth++;
+			if (depth != 2) continue;
+			char* k = pos + 1;
+			while (k < end && is_space(*k)) k++;
+			size_t rest = end - k;
+			section_type type;
+			size_t len;
+			if (rest > 5 && strncmp(k, ":init", 5) == 0) type = SECTION_INIT, len = 5;
+			else if (rest > 8 && strncmp(k, ":objects", 8) == 0) type = SECTION_OBJECTS, len = 8;
+			else continue;
+			if (is_name_char(k[len])) continue; // a different keyword
+			current.type = type;
+			current.begin = pos;
+			current.body = k + len;
+			// the elements of the section are skipped by the loop
+		} else if (c == ')'){
+			if (depth == 0) return false;
+			if (depth == 2 && current.begin){
+				current.end = pos + 1;
+				sections.push_back(current);
+			}
+			depth--;
+		}
+		if (depth < 2) current.begin = NULL;
+	}
+	return true;
+}
+
+// splits the body of a section into chunks of roughly the given size. For :init, chunks start at top level parentheses, for :objects, they start after a type
+void split_section(const problem_section & sec, size_t chunk_size, vector<section_chunk> & chunks){
+	const char* body = sec.body;
+	const char* body_end = sec.end - 1;
+	vector<const char*> boundaries;
+	boundaries.push_back(body);
+
+	if (sec.type == SECTION_INIT){
+		int depth = 0;
+		for (const char* pos = body; pos < body_end; pos++){
+			if (*pos == ';'){
+				pos = skip_comment(pos, body_end);
+				if (!pos) break; // the chunk parser will detect this
+				pos--;
+			} else if (*pos == '('){
+				if (depth == 0 && pos - boundaries.back() >= (long) chunk_size) boundaries.push_back(pos);
+				depth++;
+			} else if (*pos == ')') depth--;
+		}
+	} else {
+		chunk_scanner s(body, body_end);
+		chunk_token t;
+		while ((t = s.next()) != TOKEN_END && t != TOKEN_OTHER)
+			if (t == TOKEN_DASH && s.next() == TOKEN_NAME && s.pos - boundaries.back() >= (long) chunk_size)
+				boundaries.push_back(s.pos);
+	}
+	boundaries.push_back(body_end);
+
+	for (size_t i = 0; i + 1 < boundaries.size(); i++){
+		chunks.emplace_back();
+		section_chunk & c = chunks.back();
+		c.type = sec.type;
+		c.begin = boundaries[i];
+		c.end = boundaries[i + 1];
+		c.whole_section = boundaries.size() == 2;
+	}
+}
+
+bool parse_problem_sections(char* data, size_t size, parse_context & ctx){
+	vector<problem_section> sections;
+	if (!find_sections(data, size, sections) || sections.size() == 0) return false;
+
+	size_t total = 0;
+	for (problem_section & sec : sections) total += sec.end - sec.body;
+	unsigned int threads = max(1u, thread::hardware_concurrency());
+	size_t chunk_size = max(MIN_CHUNK_SIZE, total / threads + 1);
+
+	vector<section_chunk> chunks;
+	for (problem_section & sec : sections) split_section(sec, chunk_size, chunks);
+
+	atomic<size_t> next_chunk(0);
+	auto worker = [&](){
+		size_t i;
+		while ((i = next_chunk++) < chunks.size()){
+			if (chunks[i].type == SECTION_INIT) parse_init_chunk(chunks[i]);
+			else parse_objects_chunk(chunks[i]);
+		}
+	};
+	vector<thread> pool;
+	for (unsigned int i = 1; i < min<size_t>(threads, chunks.size()); i++) pool.emplace_back(worker);
+	worker();
+	for (thread & t : pool) t.join();
+
+	for (section_chunk & c : chunks) if (!c.ok) return false;
+
+	// merge in the order of the file
+	for (section_chunk & c : chunks){
+		if (c.type == SECTION_INIT){
+			// for each constant in a literal, the parser creates a sort containing only this constant
+			for (const string & constant : c.facts.constants) ctx.sorts["sort_for_" + constant].insert(constant);
+			ctx.init.append(c.facts);
+			ctx.init_functions.insert(ctx.init_functions.end(), c.functions.begin(), c.functions.end());
+		} else {
+			for (auto & [names, type] : c.typed_objects){
+				set<string> & sort = ctx.sorts[string(type)];
+				for (string_view name : names) sort.emplace(name);
+			}
+			if (c.untyped_objects.size()){
+				set<string> & sort = ctx.sorts["object"];
+				for (string_view name : c.untyped_objects) sort.emplace(name);
+				ctx.sort_object_needed = true;
+			}
+		}
+	}
+
+	for (problem_section & sec : sections)
+		for (char* pos = sec.begin; pos < sec.end; pos++)
+			if (*pos != '\n' && *pos != '\r') *pos = ' ';
+	return true;
+}
+
+// the elements of an :init section. Returns false if it contains anything else
+bool scan_init_section(const char* begin, const char* end, const init_fact_callback & fact, const init_function_callback & function_value, page_releaser & pages){
+	chunk_scanner s(begin, end);
+	string_view predicate;
+	vector<string_view> args;
+	int value;
+	while (true){
+		pages.advance(s.pos);
+		init_element e = read_init_element(s, predicate, args, value);
+		if (e == INIT_END) return true;
+		if (e == INIT_INVALID) return false;
+		if (e == INIT_FACT && fact) fact(predicate, args);
+		if (e == INIT_FUNCTION && function_value) function_value(predicate, args, value);
+	}
+}
+
+bool find_init_section(const char* data, size_t size, bool mapped, init_section & section){
+	vector<problem_section> sections;
+	if (!find_sections((char*) data, size, sections, page_releaser(data, mapped))) return false;
+	const problem_section* init = NULL;
+	for (problem_section & sec : sections)
+		if (sec.type == SECTION_INIT){
+			if (init) return false; // several :init sections are left to the parser
+			init = &sec;
+		}
+	page_releaser pages(init ? init->body : data, mapped);
+	if (!init || !scan_init_section(init->body, init->end - 1, nullptr, nullptr, pages)) return false;
+
+	section.begin = init->begin - data;
+	section.body = init->body - data;
+	section.end = init->end - data;
+	return true;
+}
+
+bool read_init_section(const init_section & section, const init_fact_callback & fact, const init_function_callback & function_value){
+#ifdef _WIN32
+	// without mmap, the file is read into memory up to the end of the section. It is read in the same mode as by the parser, as the offsets are those of its text
+	FILE* f = fopen(section.file_name.c_str(), "r");
+	if (!f) return false;
+	vector<char> data(section.end);
+	size_t read = 0, r;
+	while (read < data.size() && (r = fread(data.data() + read, 1, data.size() - read, f)) > 0) read += r;
+	fclose(f);
+	if (read < data.size()) return false;
+	page_releaser pages(data.data(), false);
+	return scan_init_section(data.data() + section.body, data.data() + section.end - 1, fact, function_value, pages);
+#else
+	int fd = open(section.file_name.c_str(), O_RDONLY);
+	if (fd == -1) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < section.end){
+		close(fd);
+		return false;
+	}
+	void* m = mmap(NULL, section.end, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (m == MAP_FAILED) return false;
+	// the section is read exactly once from front to back
+	madvise(m, section.end, MADV_SEQUENTIAL);
+	const char* data = (const char*) m;
+	page_releaser pages(data + section.body, true);
+	bool ok = scan_init_section(data + section.body, data + section.end - 1, fact, function_value, pages);
+	munmap(m, section.end);
+	return ok;
+#endif
+}
@@ -0,0 +1,25 @@
+#ifndef __CHUNKPARSER
+#define __CHUNKPARSER
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include "parser.hpp"
+
+using namespace std;
+
+// Fast path for the :objects and :init sections of (generated) problem files. These sections are split at element boundaries and the chunks are parsed on several threads.
+// The results are merged in the order of the file, i.e. the context is the same as after a serial parse. The sections are then overwritten by blanks (keeping line breaks, s.t. line numbers stay correct), such that the bison parser skips them.
+// If any of the sections contains something except plain facts, function values, and object declarations, nothing is done and false is returned. Such sections are left to the bison parser, which also reports errors.
+bool parse_problem_sections(char* data, size_t size, parse_context & ctx);
+
+// For the untransformed output (-h), a plain :init section is not parsed at all, but copied to the output straight from the file.
+// find_init_section checks whether the problem has exactly one :init section that contains only facts and function values and if so, stores its position. mapped tells whether data is a memory-mapped file
+bool find_init_section(const char* data, size_t size, bool mapped, init_section & section);
+
+typedef function<void(string_view predicate, const vector<string_view> & args)> init_fact_callback;
+typedef function<void(string_view function, const vector<string_view> & args, int value)> init_function_callback;
+// reads the section from its file again and passes its positive facts and function values, in the order of the file, to the callbacks. Returns false if the file has changed in between
+bool read_init_section(const init_section & section, const init_fact_callback & fact, const init_function_callback & function_value);
+
+#endif
@@ -0,0 +1,367 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#ifdef PANDA_GZIP
+#include <zlib.h>
+#endif
+#ifdef PANDA_ZSTD
+#include <zstd.h>
+#endif
+#include "compression.hpp"
+
+const size_t COMPRESSION_BUFFER_SIZE = 1 << 16;
+
+const unsigned char GZIP_MAGIC[2] = {0x1f, 0x8b};
+const unsigned char ZSTD_MAGIC[4] = {0x28, 0xb5, 0x2f, 0xfd};
+
+compression_format compression_of_bytes(const char* data, size_t len){
+	if (len >= 2 && memcmp(data, GZIP_MAGIC, 2) == 0) return COMPRESSION_GZIP;
+	if (len >= 4 && memcmp(data, ZSTD_MAGIC, 4) == 0) return COMPRESSION_ZSTD;
+	return COMPRESSION_NONE;
+}
+
+compression_format detect_compression(FILE* f){
+	struct stat st;
+	if (fstat(fileno(f), &st) != 0 || !S_ISREG(st.st_mode)) return COMPRESSION_NONE;
+	char magic[4];
+#ifdef _WIN32
+	// there is no pread, so the position of the file is restored after reading the magic bytes
+	long pos = ftell(f);
+	if (pos < 0 || fseek(f, 0, SEEK_SET) != 0) return COMPRESSION_NONE;
+	long len = fread(magic, 1, sizeof(magic), f);
+	if (fseek(f, pos, SEEK_SET) != 0) return COMPRESSION_NONE;
+#else
+	ssize_t len = pread(fileno(f), magic, sizeof(magic), 0);
+#endif
+	if (len <= 0) return COMPRESSION_NONE;
+	return compression_of_bytes(magic, len);
+}
+
+string compression_name(compression_format format){
+	if (format == COMPRESSION_GZIP) return "gzip";
+	if (format == COMPRESSION_ZSTD) return "zstd";
+	return "uncompressed";
+}
+
+bool compression_supported(compression_format format){
+#ifndef PANDA_GZIP
+	if (format == COMPRESSION_GZIP) return false;
+#endif
+#ifndef PANDA_ZSTD
+	if (format == COMPRESSION_ZSTD) return false;
+#endif
+	return true;
+}
+
+
+struct decompression_state{
+	// whether the compressed data ended exactly at the end of a gzip member or zstd frame
+	bool complete = true;
+#ifdef PANDA_GZIP
+	z_stream gzip;
+#endif
+#ifdef PANDA_ZSTD
+	ZSTD_DStream* zstd;
+#endif
+};
+
+decompressing_reader::decompressing_reader(FILE* f, const char* filename) : file(f), name(filename), in(COMPRESSION_BUFFER_SIZE) {
+	struct stat st;
+	if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode)){
+		format = detect_compression(f);
+		detected = true;
+	}
+}
+
+decompressing_reader::~decompressing_reader(){
+	if (!state) return;
+#ifdef PANDA_GZIP
+	if (format == COMPRESSION_GZIP) inflateEnd(&state->gzip);
+#endif
+#ifdef PANDA_ZSTD
+	if (format == COMPRESSION_ZSTD) ZSTD_freeDStream(state->zstd);
+#endif
+	delete state;
+}
+
+void decompressing_reader::fail(const string & message){
+	cout << "\x1b[31mError\x1b[0m while reading " << name << ": " << message << endl;
+	exit(-1);
+}
+
+bool decompressing_reader::fill(){
+	in_pos = 0;
+	in_size = fread(in.data(), 1, in.size(), file);
+	if (in_size == 0){
+		if (ferror(file)) fail("read error");
+		at_end = true;
+	}
+	return in_size > 0;
+}
+
+// the format of files that are not seekable is determined by looking at the first bytes, which are kept in the input buffer
+void decompressing_reader::start(){
+	started = true;
+	if (!detected){
+		while (in_size < sizeof(ZSTD_MAGIC)){
+			size_t r = fread(in.data() + in_size, 1, in.size() - in_size, file);
+			if (r == 0) break;
+			in_size += r;
+		}
+		if (ferror(file)) fail("read error");
+		format = compression_of_bytes(in.data(), in_size);
+		detected = true;
+	}
+
+	if (format == COMPRESSION_NONE) return;
+	if (!compression_supported(format))
+		fail("the file is " + compression_name(format) + " compressed, but pandaPIparser was built without " + compression_name(format) + " support");
+
+	state = new decompression_state;
+#ifdef PANDA_GZIP
+	if (format == COMPRESSION_GZIP){
+		memset(&state->gzip, 0, sizeof(state->gzip));
+		// 16: expect a gzip header
+		if (inflateInit2(&state->gzip, 15 + 16) != Z_OK) fail("could not initialise zlib");
+	}
+#endif
+#ifdef PANDA_ZSTD
+	if (format == COMPRESSION_ZSTD){
+		state->zstd = ZSTD_createDStream();
+		if (!state->zstd || ZSTD_isError(ZSTD_initDStream(state->zstd))) fail("could not initialise zstd");
+	}
+#endif
+}
+
+void decompressing_reader::skip(size_t begin, size_t end){
+	skip_begin = begin;
+	skip_end = end;
+}
+
+size_t decompressing_reader::read(char* buf, size_t max){
+	while (true){
+		size_t n = read_contents(buf, max);
+		size_t start = position;
+		position += n;
+		if (n == 0 || position <= skip_begin || start >= skip_end) return n;
+
+		// drop the skipped part of the buffer. If nothing remains, we have to read on, as returning 0 would end the file
+		size_t from = skip_begin > start ? skip_begin - start : 0;
+		size_t to = min(n, skip_end - start);
+		size_t kept = from;
+		for (size_t i = from; i < to; i++)
+			if (buf[i] == '\n') buf[kept++] = '\n';
+		memmove(buf + kept, buf + to, n - to);
+		kept += n - to;
+		if (kept) return kept;
+	}
+}
+
+size_t decompressing_reader::read_contents(char* buf, size_t max){
+	if (!started) start();
+
+	if (format == COMPRESSION_NONE){
+		// first hand out the bytes read for detection
+		if (in_pos < in_size){
+			size_t n = min(max, in_size - in_pos);
+			memcpy(buf, in.data() + in_pos, n);
+			in_pos += n;
+			return n;
+		}
+		size_t n = fread(buf, 1, max, file);
+		if (n == 0 && ferror(file)) fail("read error");
+		return n;
+	}
+
+	while (true){
+		if (in_pos == in_size && !at_end) fill();
+		size_t produced = 0;
+#ifdef PANDA_GZIP
+		if (format == COMPRESSION_GZIP){
+			z_stream & z = state->gzip;
+			z.next_in = (Bytef*) in.data() + in_pos;
+			z.avail_in = in_size - in_pos;
+			z.next_out = (Bytef*) buf;
+			z.avail_out = max;
+			int r = inflate(&z, Z_NO_FLUSH);
+			size_t consumed = (in_size - in_pos) - z.avail_in;
+			in_pos += consumed;
+			produced = max - z.avail_out;
+			if (r == Z_STREAM_END){
+				// there might be further members in the file
+				state->complete = true;
+				inflateReset(&z);
+			} else if (r == Z_OK){
+				if (consumed) state->complete = false;
+			} else if (r != Z_BUF_ERROR)
+				fail(string("corrupt gzip data") + (z.msg ? string(" (") + z.msg + ")" : ""));
+		}
+#endif
+#ifdef PANDA_ZSTD
+		if (format == COMPRESSION_ZSTD){
+			ZSTD_inBuffer input = {in.data(), in_size, in_pos};
+			ZSTD_outBuffer output = {buf, max, 0};
+			size_t r = ZSTD_decompressStream(state->zstd, &output, &input);
+			if (ZSTD_isError(r)) fail(string("corrupt zstd data (") + ZSTD_getErrorName(r) + ")");
+			// without progress, r is just a hint for the next frame
+			if (input.pos != in_pos || output.pos) state->complete = r == 0;
+			in_pos = input.pos;
+			produced = output.pos;
+		}
+#endif
+		if (produced) return produced;
+		if (in_pos == in_size && at_end){
+			if (!state->complete) fail("unexpected end of compressed data");
+			return 0;
+		}
+	}
+}
+
+
+// stream buffer that compresses everything written to it into a file
+class compressing_streambuf : public streambuf{
+	public:
+		compressing_streambuf(FILE* f, compression_format fmt) : file(f), format(fmt), buffer(COMPRESSION_BUFFER_SIZE), out(COMPRESSION_BUFFER_SIZE) {
+			setp(buffer.data(), buffer.data() + buffer.size());
+#ifdef PANDA_GZIP
+			if (format == COMPRESSION_GZIP){
+				memset(&gzip, 0, sizeof(gzip));
+				ok = deflateInit2(&gzip, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+			}
+#endif
+#ifdef PANDA_ZSTD
+			if (format == COMPRESSION_ZSTD){
+				zstd = ZSTD_createCCtx();
+				ok = zstd != NULL;
+			}
+#endif
+		}
+
+		// writes all remaining data and the end of the compressed stream
+		bool finish(){
+			if (finished) return ok;
+			compress(pbase(), pptr() - pbase(), true);
+			finished = true;
+#ifdef PANDA_GZIP
+			if (format == COMPRESSION_GZIP) deflateEnd(&gzip);
+#endif
+#ifdef PANDA_ZSTD
+			if (format == COMPRESSION_ZSTD) ZSTD_freeCCtx(zstd);
+#endif
+			if (fclose(file) != 0) ok = false;
+			return ok;
+		}
+
+	protected:
+		int overflow(int c) override{
+			if (finished) return traits_type::eof();
+			compress(pbase(), pptr() - pbase(), false);
+			setp(buffer.data(), buffer.data() + buffer.size());
+			if (c != traits_type::eof()) sputc(c);
+			return ok ? traits_type::not_eof(c) : traits_type::eof();
+		}
+
+		// the writers flush after every line. A partially written compressed stream is useless anyway, so we just keep buffering
+		int sync() override{
+			return ok ? 0 : -1;
+		}
+
+	private:
+		FILE* file;
+		compression_format format;
+		vector<char> buffer;
+		vector<char> out;
+		bool ok = true;
+		bool finished = false;
+#ifdef PANDA_GZIP
+		z_stream gzip;
+#endif
+#ifdef PANDA_ZSTD
+		ZSTD_CCtx* zstd;
+#endif
+
+		void write(size_t len){
+			if (len && fwrite(out.data(), 1, len, file) != len) ok = false;
+		}
+
+		void compress(const char* data, size_t len, bool end){
+			if (!ok) return;
+#ifdef PANDA_GZIP
+			if (format == COMPRESSION_GZIP){
+				gzip.next_in = (Bytef*) data;
+				gzip.avail_in = len;
+				int r;
+				do {
+					gzip.next_out = (Bytef*) out.data();
+					gzip.avail_out = out.size();
+					r = deflate(&gzip, end ? Z_FINISH : Z_NO_FLUSH);
+					write(out.size() - gzip.avail_out);
+				} while (ok && (gzip.avail_out == 0 || (end && r != Z_STREAM_END)));
+			}
+#endif
+#ifdef PANDA_ZSTD
+			if (format == COMPRESSION_ZSTD){
+				ZSTD_inBuffer input = {data, len, 0};
+				size_t remaining;
+				do {
+					ZSTD_outBuffer output = {out.data(), out.size(), 0};
+					remaining = ZSTD_compressStream2(zstd, &output, &input, end ? ZSTD_e_end : ZSTD_e_continue);
+					if (ZSTD_isError(remaining)) { ok = false; return; }
+					write(output.pos);
+				} while (ok && (input.pos < input.size || (end && remaining != 0)));
+			}
+#endif
+		}
+};
+
+class compressed_ostream : public ostream{
+	public:
+		compressed_ostream(FILE* f, compression_format format) : ostream(NULL), buf(f, format) { rdbuf(&buf); }
+		bool finish(){ flush(); return buf.finish(); }
+	private:
+		compressing_streambuf buf;
+};
+
+vector<pair<compressed_ostream*,string>> open_compressed_files;
+
+bool has_suffix(const string & s, const string & suffix){
+	return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+ostream* open_output_file(const string & name){
+	compression_format format = COMPRESSION_NONE;
+	if (has_suffix(name, ".gz")) format = COMPRESSION_GZIP;
+	else if (has_suffix(name, ".zst")) format = COMPRESSION_ZSTD;
+
+	if (format == COMPRESSION_NONE){
+		ofstream * of = new ofstream(name);
+		if (of->is_open()) return of;
+		delete of;
+		return NULL;
+	}
+
+	if (!compression_supported(format)){
+		cout << "pandaPIparser was built without " << compression_name(format) << " support, it cannot write " << name << endl;
+		return NULL;
+	}
+	FILE* f = fopen(name.c_str(), "wb");
+	if (!f) return NULL;
+	static bool close_at_exit = false;
+	if (!close_at_exit) close_at_exit = (atexit(close_output_files) == 0);
+	compressed_ostream * s = new compressed_ostream(f, format);
+	open_compressed_files.push_back(make_pair(s, name));
+	return s;
+}
+
+void close_output_files(){
+	for (auto & [s, name] : open_compressed_files){
+		if (!s->finish()) cout << "\x1b[31mError\x1b[0m while writing " << name << endl;
+		delete s;
+	}
+	open_compressed_files.clear();
+}
@@ -0,0 +1,64 @@
+#ifndef __COMPRESSION
+#define __COMPRESSION
+
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Input files are decompressed on the fly if they start with the magic bytes of gzip or zstd. Output files whose name ends in .gz or .zst are compressed.
+// gzip support needs zlib (compile with -DPANDA_GZIP), zstd support libzstd (-DPANDA_ZSTD).
+
+enum compression_format {COMPRESSION_NONE, COMPRESSION_GZIP, COMPRESSION_ZSTD};
+
+// determines the format of a regular file by its magic bytes, without changing the read position
+compression_format detect_compression(FILE* f);
+// name of the format for messages
+string compression_name(compression_format format);
+
+
+struct decompression_state;
+
+// reads a file and decompresses it, if necessary. For regular files, the format is known in advance, for other files (e.g. pipes) it is detected from the first bytes read
+class decompressing_reader{
+	public:
+		decompressing_reader(FILE* f, const char* filename);
+		~decompressing_reader();
+		decompressing_reader(const decompressing_reader &) = delete;
+
+		// reads up to max bytes of the decompressed contents. Returns 0 at the end of the file. On errors, a message is printed and the program exits
+		size_t read(char* buf, size_t max);
+		// the bytes of the contents in [begin,end) are left out, except for line breaks (s.t. the scanner still counts lines correctly)
+		void skip(size_t begin, size_t end);
+
+	private:
+		FILE* file;
+		string name;
+		compression_format format;
+		bool detected = false;
+		bool started = false;
+		bool at_end = false;
+		vector<char> in;
+		size_t in_pos = 0;
+		size_t in_size = 0;
+		decompression_state* state = NULL;
+		// position of the next byte of the contents
+		size_t position = 0;
+		size_t skip_begin = 0;
+		size_t skip_end = 0;
+
+		size_t read_contents(char* buf, size_t max);
+		void start();
+		bool fill();
+		void fail(const string & message);
+};
+
+
+// opens the output file with the given name. Returns NULL if the file cannot be opened. If the name ends in .gz or .zst the output is compressed
+ostream* open_output_file(const string & name);
+// finishes all compressed output files. This is also done automatically at exit
+void close_output_files();
+
+#endif
@@ -1,12 +1,19 @@
 #include "cwa.hpp"
 #include "domain.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
+#include <thread>
+#include <unordered_set>
 
-vector<ground_literal> init;
+fact_store init;
 vector<pair<ground_literal,int>> init_functions;
 vector<ground_literal> goal;
 general_formula* goal_formula = NULL;
+bool implicit_cwa = false;
+set<string> closed_world_predicates;
 
 bool operator< (const ground_literal& lhs, const ground_literal& rhs){
 	if (lhs.predicate < rhs.predicate) return true;
@@ -21,6 +28,72 @@ bool operator< (const ground_literal& lhs, const ground_literal& rhs){
 	return false; // equal
 }
 
+size_t predicate_facts::number_of_facts(bool pos) const{
+	if (arity == 0) return pos ? positive.size() : negative.size();
+	return (pos ? positive.size() : negative.size()) / arity;
+}
+
+int fact_store::constant_id(const string & c){
+	auto it = constant_ids.find(c);
+	if (it != constant_ids.end()) return it->second;
+	int id = constants.size();
+	constant_ids[c] = id;
+	constants.push_back(c);
+	return id;
+}
+
+void predicate_facts::add(bool pos, const vector<int> & args){
+	arity = args.size();
+	vector<int> & column = pos ? positive : negative;
+	// nullary facts have no arguments to store, so we store a dummy to be able to count them
+	if (args.size() == 0) column.push_back(-1);
+	else column.insert(column.end(), args.begin(), args.end());
+}
+
+void fact_store::add(const string & predicate, bool positive, const vector<int> & args){
+	predicates[predicate].add(positive, args);
+}
+
+void fact_store::add(const ground_literal & l){
+	vector<int> args;
+	for (const string & c : l.args) args.push_back(constant_id(c));
+	add(l.predicate, l.positive, args);
+}
+
+void fact_store::append(const fact_store & other){
+	vector<int> translation;
+	for (const string & c : other.constants) translation.push_back(constant_id(c));
+
+	for (auto & [predicate, other_facts] : other.predicates){
+		predicate_facts & facts = predicates[predicate];
+		facts.arity = other_facts.arity;
+		for (int id : other_facts.positive) facts.positive.push_back(id == -1 ? -1 : translation[id]);
+		for (int id : other_facts.negative) facts.negative.push_back(id == -1 ? -1 : translation[id]);
+	}
+}
+
+size_t fact_store::size() const{
+	size_t s = 0;
+	for (auto & [_, facts] : predicates) s += facts.number_of_facts(true) + facts.number_of_facts(false);
+	return s;
+}
+
+vector<ground_literal> fact_store::literals() const{
+	vector<ground_literal> ret;
+	for (auto & [predicate, facts] : predicates)
+		for (bool pos : {true, false}){
+			const vector<int> & column = pos ? facts.positive : facts.negative;
+			for (size_t f = 0; f < facts.number_of_facts(pos); f++){
+				ground_literal l;
+				l.predicate = predicate;
+				l.positive = pos;
+				for (int i = 0; i < facts.arity; i++) l.args.push_back(constants[column[f * facts.arity + i]]);
+				ret.push_back(l);
+			}
+		}
+	return ret;
+}
+
 void flatten_goal(){
 	if (goal_formula == NULL) return;
 	vector<pair<pair<vector<variant<literal,conditional_effect>>,vector<literal> >, additional_variables> > ex = goal_formula->expand(false);
@@ -47,89 +120,346 @@ void flatten_goal(){
 
 
 map<string,vector<int> > int_sorts;
-map<string,int> const_int;
 vector<string> int_const;
 
+// argument tuples of a predicate are numbered in mixed radix over the constants each position can take, ordered by name. Tuples of one combination of sorts
+// are thus numbered in the order in which they are instantiated. The tuples already known are kept in a bitset if there are at most this many tuples and the
+// bitset takes no more memory than a hash set of the tuples that can be stored in it, whose entries take about 32 bytes. Otherwise they are kept in a hash set
+const uint64_t DENSE_TUPLE_LIMIT = uint64_t(1) << 30;
+const uint64_t DENSE_BITS_PER_TUPLE = 256;
 
-// fully instantiate predicate via recursion
-void fully_instantiate(int * inst, unsigned int pos, vector<string> & arg_sorts, vector<vector<int>> & result){
-	if (pos == arg_sorts.size()){
-		vector<int> instance(inst,inst + arg_sorts.size());
-		result.push_back(instance);
-		return;
+struct tuple_set{
+	bool dense;
+	vector<uint64_t> bits;
+	unordered_set<uint64_t> sparse;
+
+	// returns whether the tuple was new
+	bool insert(uint64_t t){
+		if (!dense) return sparse.insert(t).second;
+		uint64_t & word = bits[t / 64];
+		uint64_t bit = uint64_t(1) << (t % 64);
+		if (word & bit) return false;
+		word |= bit;
+		return true;
 	}
+};
 
-	for (int c : int_sorts[arg_sorts[pos]]) {
-		inst[pos] = c;
-		fully_instantiate(inst,pos+1,arg_sorts,result);
+// the instances of a negative literal that can ever be queried: the constants each argument can take, ordered by name, and static predicates over several of
+// its arguments whose facts of the initial state the instances have to match
+struct relevant_tuples{
+	vector<string> arg_sorts;
+	vector<vector<int>> domains;
+	vector<pair<string,vector<int>>> filters; // predicate and the position of each of its arguments in the tuple
+
+	bool operator< (const relevant_tuples & other) const{
+		return tie(arg_sorts, domains, filters) < tie(other.arg_sorts, other.domains, other.filters);
 	}
+};
+
+// positive facts of the initial state of the predicates no action changes
+map<string,set<vector<int>>> static_facts;
+
+uint64_t saturating_product(uint64_t a, uint64_t b){
+	return b && a > UINT64_MAX / b ? UINT64_MAX : a * b;
 }
 
+// an upper bound of the number of tuples of r. A filter admits at most one combination of the positions it covers per fact
+uint64_t relevant_tuple_bound(const relevant_tuples & r){
+	uint64_t bound = 1;
+	for (const vector<int> & d : r.domains) bound = saturating_product(bound, d.size());
+	for (const auto & [filter, positions] : r.filters){
+		vector<bool> covered(r.domains.size(), false);
+		for (int i : positions) covered[i] = true;
+		uint64_t b = static_facts.at(filter).size();
+		for (size_t i = 0; i < r.domains.size(); i++) if (!covered[i]) b = saturating_product(b, r.domains[i].size());
+		bound = min(bound, b);
+	}
+	return bound;
+}
 
-void compute_cwa(){
-	// transform sort representation to ints
-	for (auto & s : sorts){
-		for (string c : s.second){
-			auto it = const_int.find(c);
-			int id;
-			if (it == const_int.end()) {
-				id = const_int.size();
-				const_int[c] = id;
-				int_const.push_back(c);
-			} else id = it->second;
-			int_sorts[s.first].push_back(id);
+// the negative facts of one predicate as consecutive constant ids, in the order in which the combinations of sorts instantiate them
+vector<int> negative_facts(const string & predicate, const set<relevant_tuples> & relevant){
+	size_t arity = relevant.begin()->arg_sorts.size();
+
+	// the constants each position can take and their ranks
+	vector<vector<int>> domain(arity);
+	vector<vector<int>> rank(arity, vector<int>(int_const.size(), -1));
+	uint64_t universe = 1;
+	bool dense = true;
+	for (size_t i = 0; i < arity; i++){
+		for (const relevant_tuples & r : relevant)
+			for (int c : r.domains[i]) if (rank[i][c] == -1){
+				rank[i][c] = 0;
+				domain[i].push_back(c);
+			}
+		sort(domain[i].begin(), domain[i].end(), [&](int a, int b){ return int_const[a] < int_const[b]; });
+		for (size_t r = 0; r < domain[i].size(); r++) rank[i][domain[i][r]] = r;
+		if (domain[i].empty()) return vector<int>();
+		if (universe > DENSE_TUPLE_LIMIT / domain[i].size()) dense = false;
+		universe *= domain[i].size();
+	}
+
+	// the bitset covers the whole universe, but only the tuples of the initial state and the relevant ones are ever stored
+	auto init_facts = init.predicates.find(predicate);
+	uint64_t stored = 0;
+	if (init_facts != init.predicates.end()) stored = init_facts->second.number_of_facts(true) + init_facts->second.number_of_facts(false);
+	for (const relevant_tuples & r : relevant){
+		uint64_t bound = relevant_tuple_bound(r);
+		stored = bound > UINT64_MAX - stored ? UINT64_MAX : stored + bound;
+	}
+	if (dense && universe / DENSE_BITS_PER_TUPLE > stored) dense = false;
+
+	tuple_set known;
+	known.dense = dense;
+	if (dense) known.bits.resize((universe + 63) / 64, 0);
+
+	// facts of the initial state are never added
+	if (init_facts != init.predicates.end()){
+		const predicate_facts & facts = init_facts->second;
+		for (bool pos : {true, false}){
+			const vector<int> & column = pos ? facts.positive : facts.negative;
+			for (size_t f = 0; f < facts.number_of_facts(pos); f++){
+				uint64_t t = 0;
+				bool in_domain = true;
+				for (size_t i = 0; i < arity && in_domain; i++){
+					int r = rank[i][column[f * arity + i]];
+					in_domain = r != -1;
+					t = t * domain[i].size() + r;
+				}
+				if (in_domain) known.insert(t);
+			}
 		}
 	}
 
+	vector<int> result;
+	auto add_tuple = [&](uint64_t t){
+		size_t start = result.size();
+		result.resize(start + arity);
+		for (size_t i = arity; i-- > 0;){
+			result[start + i] = domain[i][t % domain[i].size()];
+			t /= domain[i].size();
+		}
+	};
+	// nullary facts have no arguments, the store keeps a dummy for them
+	auto add_nullary = [&](){ result.push_back(-1); };
 
-	// find predicates occurring negatively in preconditions and their types
-	map<string,set<vector<string>>> neg_predicates_with_arg_sorts;
-	
-	for (task t : primitive_tasks) {
-		vector<literal> literals = t.prec;
-		for (conditional_effect ceff : t.ceff)
-			for (literal l : ceff.condition)
-				literals.push_back(l);
-		
-		for (literal l : literals) if (!l.positive) {
-			vector<string> argSorts;
-			for (string v : l.arguments) for (auto x : t.vars) if (x.first == v) argSorts.push_back(x.second);
-			assert(argSorts.size() == l.arguments.size());
-			neg_predicates_with_arg_sorts[l.predicate].insert(argSorts);
+	for (const relevant_tuples & r : relevant){
+		bool whole_universe = dense && r.filters.empty();
+		for (size_t i = 0; i < arity; i++) whole_universe &= r.domains[i].size() == domain[i].size();
+
+		if (whole_universe){
+			// the complement of the known tuples, one word at a time
+			for (size_t w = 0; w < known.bits.size(); w++){
+				uint64_t valid = (w + 1) * 64 <= universe ? ~uint64_t(0) : (uint64_t(1) << (universe % 64)) - 1;
+				for (uint64_t missing = ~known.bits[w] & valid; missing; missing &= missing - 1){
+					if (arity == 0) add_nullary();
+					else add_tuple(w * 64 + __builtin_ctzll(missing));
+				}
+				known.bits[w] |= valid;
+			}
+			continue;
+		}
+
+		// enumerate the tuples of the combination in increasing order
+		vector<vector<int>> ranks(arity);
+		for (size_t i = 0; i < arity; i++)
+			for (int c : r.domains[i]) ranks[i].push_back(rank[i][c]);
+		bool empty = false;
+		for (size_t i = 0; i < arity; i++) empty |= ranks[i].empty();
+		if (empty) continue;
+
+		vector<const set<vector<int>>*> filter_facts;
+		for (const auto & [filter, _] : r.filters) filter_facts.push_back(&static_facts.at(filter));
+
+		vector<size_t> position(arity, 0);
+		vector<int> args;
+		while (true){
+			bool matches = true;
+			for (size_t f = 0; f < r.filters.size() && matches; f++){
+				args.clear();
+				for (int i : r.filters[f].second) args.push_back(r.domains[i][position[i]]);
+				matches = filter_facts[f]->count(args);
+			}
+
+			uint64_t t = 0;
+			for (size_t i = 0; i < arity; i++) t = t * domain[i].size() + ranks[i][position[i]];
+			if (matches && known.insert(t)) add_tuple(t);
+
+			size_t i = arity;
+			while (i > 0 && ++position[i - 1] == ranks[i - 1].size()) position[--i] = 0;
+			if (i == 0) break;
 		}
 	}
-	
-	// predicates negative in goal
+	return result;
+}
+
+
+// restricts the instances of the negative literal l to those the static positive literals of its condition admit. The domains of the condition's variables are
+// shrunk until each of their constants is supported by an initial fact of every static literal. Returns false if the condition can never hold
+bool relevant_instances(const literal & l, const vector<pair<string,string>> & vars, const vector<const vector<literal>*> & condition, relevant_tuples & r){
+	map<string,string> sort_of;
+	for (auto & [v, s] : vars) sort_of.insert({v, s});
+	auto sort_elements = [&](const string & v) -> const vector<int> & {
+		static const vector<int> no_elements;
+		auto it = int_sorts.find(sort_of[v]);
+		return it == int_sorts.end() ? no_elements : it->second;
+	};
+
+	map<string,set<int>> domain;
+	for (auto & [v, _] : sort_of) domain[v] = set<int>(sort_elements(v).begin(), sort_elements(v).end());
+
+	vector<const literal*> static_literals;
+	for (const vector<literal> * literals : condition)
+		for (const literal & s : *literals){
+			if (!s.positive || !static_facts.count(s.predicate)) continue;
+			bool known_variables = true;
+			for (const string & v : s.arguments) known_variables &= domain.count(v) > 0;
+			if (known_variables) static_literals.push_back(&s);
+		}
+
+	bool changed = true;
+	while (changed){
+		changed = false;
+		for (const literal * s : static_literals){
+			size_t arity = s->arguments.size();
+			vector<set<int>> supported(arity);
+			bool satisfiable = false;
+			for (const vector<int> & f : static_facts.at(s->predicate)){
+				bool fits = true;
+				for (size_t j = 0; j < arity && fits; j++){
+					fits = domain[s->arguments[j]].count(f[j]);
+					for (size_t k = 0; k < j && fits; k++) fits = s->arguments[k] != s->arguments[j] || f[k] == f[j];
+				}
+				if (!fits) continue;
+				satisfiable = true;
+				for (size_t j = 0; j < arity; j++) supported[j].insert(f[j]);
+			}
+			if (!satisfiable) return false;
+
+			for (size_t j = 0; j < arity; j++){
+				set<int> & d = domain[s->arguments[j]];
+				if (d.size() == supported[j].size()) continue;
+				d = supported[j];
+				changed = true;
+			}
+		}
+	}
+
+	for (const string & v : l.arguments){
+		assert(sort_of.count(v));
+		r.arg_sorts.push_back(sort_of[v]);
+		r.domains.emplace_back();
+		for (int c : sort_elements(v)) if (domain[v].count(c)) r.domains.back().push_back(c);
+		if (r.domains.back().empty()) return false;
+	}
+
+	// static literals over several of the literal's arguments and nothing else also restrict their combinations
+	for (const literal * s : static_literals){
+		vector<int> positions;
+		set<string> distinct;
+		for (const string & v : s->arguments){
+			auto it = find(l.arguments.begin(), l.arguments.end(), v);
+			if (it == l.arguments.end()) break;
+			positions.push_back(it - l.arguments.begin());
+			distinct.insert(v);
+		}
+		if (positions.size() == s->arguments.size() && distinct.size() > 1) r.filters.push_back({s->predicate, positions});
+	}
+	sort(r.filters.begin(), r.filters.end());
+	r.filters.erase(unique(r.filters.begin(), r.filters.end()), r.filters.end());
+	return true;
+}
+
+void compute_cwa(){
+	// calls back for every literal of a precondition or effect condition that is negative, with the variables it can use and the literals that hold with it
+	auto for_each_negative = [&](auto callback){
+		for (const task & t : primitive_tasks) {
+			for (const literal & l : t.prec) if (!l.positive) callback(l, t.vars, vector<const vector<literal>*>{&t.prec});
+			for (const conditional_effect & ceff : t.ceff)
+				for (const literal & l : ceff.condition) if (!l.positive) callback(l, t.vars, vector<const vector<literal>*>{&t.prec, &ceff.condition});
+
+			// lifted quantifiers have their own variables in addition to the task's
+			for (const vector<quantified_literals> * lifted : {&t.forall_prec, &t.forall_eff})
+				for (const quantified_literals & q : *lifted){
+					vector<pair<string,string>> vars = t.vars;
+					vars.insert(vars.end(), q.vars.begin(), q.vars.end());
+					const vector<literal> & literals = lifted == &t.forall_prec ? q.literals : q.condition;
+					for (const literal & l : literals) if (!l.positive) callback(l, vars, vector<const vector<literal>*>{&t.prec, &literals});
+				}
+		}
+	};
+
+	// the grounder derives the negative facts from the positive ones
+	if (implicit_cwa){
+		for_each_negative([&](const literal & l, const vector<pair<string,string>> &, const vector<const vector<literal>*> &){
+			closed_world_predicates.insert(l.predicate);
+		});
+		for (auto l : goal) if (!l.positive) closed_world_predicates.insert(l.predicate);
+		return;
+	}
+
+	// predicates negative in goal, their arguments get sorts of their own
+	vector<pair<string,vector<string>>> negative_goal;
 	for (auto l : goal) if (!l.positive) {
 		vector<string> args;
 		for (string c : l.args) args.push_back(sort_for_const(c));
-		neg_predicates_with_arg_sorts[l.predicate].insert(args);
-	} 
+		negative_goal.push_back({l.predicate, args});
+	}
 
-	map<string,set<vector<int>>> init_check;
-	for(auto l : init){
-		vector<int> args;
-		for (string & arg : l.args) args.push_back(const_int[arg]);
-		init_check[l.predicate].insert(args);
-	}
-
-	for (auto np : neg_predicates_with_arg_sorts){
-		set<vector<int>> instantiations;
-
-		for (vector<string> arg_sorts : np.second){
-			vector<vector<int>> inst;
-			int * partial_instance = new int[arg_sorts.size()];
-			fully_instantiate(partial_instance, 0, arg_sorts, inst);
-			delete[] partial_instance;
-
-			for (vector<int> & p : inst) if (instantiations.count(p) == 0){
-				instantiations.insert(p);
-				if (init_check[np.first].count(p)) continue;
-				ground_literal lit; lit.predicate = np.first;
-				for (int arg : p) lit.args.push_back(int_const[arg]);
-				lit.positive = false;
-				init.push_back(lit);
-			}
-		}
+	// transform sort representation to ints, using the ids of the initial state's constants
+	for (auto & s : sorts)
+		for (string c : s.second)
+			int_sorts[s.first].push_back(init.constant_id(c));
+	int_const = init.constants;
+
+	// predicates no action changes only ever have the positive facts of the initial state
+	set<string> changed_predicates;
+	for (const task & t : primitive_tasks) {
+		for (const literal & l : t.eff) changed_predicates.insert(l.predicate);
+		for (const conditional_effect & ceff : t.ceff) changed_predicates.insert(ceff.effect.predicate);
+		for (const quantified_literals & q : t.forall_eff)
+			for (const literal & l : q.literals) changed_predicates.insert(l.predicate);
+	}
+	static_facts.clear();
+	for (const predicate_definition & p : predicate_definitions) if (!changed_predicates.count(p.name)){
+		set<vector<int>> & facts = static_facts[p.name];
+		auto it = init.predicates.find(p.name);
+		if (it == init.predicates.end()) continue;
+		const predicate_facts & f = it->second;
+		for (size_t i = 0; i < f.number_of_facts(true); i++)
+			facts.insert(vector<int>(f.positive.begin() + i * f.arity, f.positive.begin() + (i + 1) * f.arity));
+	}
+
+	// only instances of negative literals that the static part of their condition admits are ever queried
+	map<string,set<relevant_tuples>> neg_predicates_with_relevant_tuples;
+	for_each_negative([&](const literal & l, const vector<pair<string,string>> & vars, const vector<const vector<literal>*> & condition){
+		relevant_tuples r;
+		if (relevant_instances(l, vars, condition, r)) neg_predicates_with_relevant_tuples[l.predicate].insert(r);
+	});
+	for (auto & [predicate, args] : negative_goal){
+		relevant_tuples r;
+		r.arg_sorts = args;
+		for (const string & s : args) r.domains.push_back(int_sorts[s]);
+		neg_predicates_with_relevant_tuples[predicate].insert(r);
+	}
+
+	// the predicates are instantiated on all cores, their facts are added in the same order as before
+	vector<pair<string,set<relevant_tuples>>> negative(neg_predicates_with_relevant_tuples.begin(), neg_predicates_with_relevant_tuples.end());
+	vector<vector<int>> facts(negative.size());
+	atomic<size_t> next(0);
+	auto worker = [&](){
+		size_t p;
+		while ((p = next++) < negative.size()) facts[p] = negative_facts(negative[p].first, negative[p].second);
+	};
+	vector<thread> pool;
+	for (unsigned int i = 1; i < min<size_t>(max(1u, thread::hardware_concurrency()), negative.size()); i++) pool.emplace_back(worker);
+	worker();
+	for (thread & t : pool) t.join();
+
+	for (size_t p = 0; p < negative.size(); p++){
+		if (facts[p].empty()) continue;
+		predicate_facts & f = init.predicates[negative[p].first];
+		f.arity = negative[p].second.begin()->arg_sorts.size();
+		f.negative.insert(f.negative.end(), facts[p].begin(), facts[p].end());
 	}
 }
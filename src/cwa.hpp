@@ -2,7 +2,10 @@
 #define __CWA
 
 #include <vector>
+#include <map>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include "parsetree.hpp"
 
 using namespace std;
@@ -15,10 +18,44 @@ struct ground_literal{
 
 bool operator< (const ground_literal& lhs, const ground_literal& rhs);
 
+// all facts of one predicate. Each fact is stored as arity many consecutive constant ids
+struct predicate_facts{
+	int arity = 0;
+	vector<int> positive;
+	vector<int> negative;
+
+	size_t number_of_facts(bool pos) const;
+	void add(bool positive, const vector<int> & args);
+};
+
+// column-wise, integer encoded store for ground facts, used for the initial state
+class fact_store{
+	public:
+		map<string,predicate_facts> predicates;
+		vector<string> constants; // id -> name
+
+		int constant_id(const string & c);
+		void add(const ground_literal & l);
+		void add(const string & predicate, bool positive, const vector<int> & args);
+		// adds all facts of the other store, translating its constant ids
+		void append(const fact_store & other);
+
+		size_t size() const;
+		// the facts as literals, ordered by predicate with positive facts first
+		vector<ground_literal> literals() const;
+	private:
+		unordered_map<string,int> constant_ids;
+};
+
 void flatten_goal();
 void compute_cwa();
 
-extern vector<ground_literal> init;
+// whether the negative facts of the closed world assumption are left to the grounder. compute_cwa then only marks the predicates
+extern bool implicit_cwa;
+// the predicates whose negative facts are implied by the closed world assumption
+extern set<string> closed_world_predicates;
+
+extern fact_store init;
 extern vector<pair<ground_literal,int>> init_functions;
 extern vector<ground_literal> goal;
 extern general_formula* goal_formula;
@@ -6,6 +6,8 @@
 #include <cassert>
 #include <algorithm>
 #include <functional>
+#include <atomic>
+#include <thread>
 
 using namespace std;
 
@@ -30,38 +32,183 @@ void addAbstractTask(task & t){
 	task_name_map[t.name] = t;
 }
 
+// actions and methods are lowered independently of each other on several threads. Everything created for one of them is collected first and then added in the order of the input,
+// s.t. the result is the same as if they had been lowered one after the other
+struct lowering_result{
+	vector<task> primitive_tasks;
+	vector<task> abstract_tasks;
+	vector<method> methods;
+	vector<predicate_definition> predicates;
+	// which of the tasks and methods are checked for integrity. This can only be done once all of them have been added
+	vector<bool> check_primitive_task, check_abstract_task, check_method;
+	string error;
+
+	void add_primitive_task(task & t, bool check){
+		primitive_tasks.push_back(t);
+		check_primitive_task.push_back(check);
+	}
+
+	void add_abstract_task(task & t, bool check){
+		abstract_tasks.push_back(t);
+		check_abstract_task.push_back(check);
+	}
+
+	void add_method(method & m, bool check){
+		methods.push_back(m);
+		check_method.push_back(check);
+	}
+};
+
+// runs work(k) for all k < n on all cores. The items for which ordered(k) holds are run one after the other in increasing order on the same thread
+void lower_in_parallel(size_t n, const function<bool(size_t)> & ordered, const function<void(size_t)> & work){
+	vector<size_t> in_order, any_order;
+	for (size_t k = 0; k < n; k++) (ordered(k) ? in_order : any_order).push_back(k);
+
+	atomic<size_t> next(0);
+	auto worker = [&](){
+		size_t j;
+		while ((j = next++) < any_order.size()) work(any_order[j]);
+	};
+	unsigned int threads = max(1u, thread::hardware_concurrency());
+	vector<thread> pool;
+	for (unsigned int i = 1; i < min<size_t>(threads, n); i++) pool.emplace_back(worker);
+	for (size_t k : in_order) work(k);
+	worker();
+	for (thread & t : pool) t.join();
+}
+
+void add_lowering_results(vector<lowering_result> & results){
+	vector<task*> check_tasks;
+	vector<method*> check_methods;
+	for (lowering_result & r : results){
+		if (r.error.size()){
+			cout << r.error << endl;
+			exit(1);
+		}
+		for (size_t k = 0; k < r.primitive_tasks.size(); k++){
+			addPrimitiveTask(r.primitive_tasks[k]);
+			if (r.check_primitive_task[k]) check_tasks.push_back(&r.primitive_tasks[k]);
+		}
+		for (size_t k = 0; k < r.abstract_tasks.size(); k++){
+			addAbstractTask(r.abstract_tasks[k]);
+			if (r.check_abstract_task[k]) check_tasks.push_back(&r.abstract_tasks[k]);
+		}
+		methods.insert(methods.end(), r.methods.begin(), r.methods.end());
+		for (size_t k = 0; k < r.methods.size(); k++)
+			if (r.check_method[k]) check_methods.push_back(&r.methods[k]);
+		predicate_definitions.insert(predicate_definitions.end(), r.predicates.begin(), r.predicates.end());
+	}
+
+	lower_in_parallel(check_tasks.size() + check_methods.size(), [](size_t){ return false; }, [&](size_t k){
+			if (k < check_tasks.size()) check_tasks[k]->check_integrity();
+			else check_methods[k - check_tasks.size()]->check_integrity();
+		});
+	results.clear();
+}
 
 
 pair<task,bool> flatten_primitive_task(parsed_task & a,
 							bool compileConditionalEffects,
 							bool linearConditionalEffectExpansion,
 							bool encodeDisjunctivePreconditionsInMethods,
-							bool isArtificial
+							bool isArtificial,
+							lowering_result & out
 							){
 	// first check whether this primitive as a disjunctive precondition
 	bool disjunctivePreconditionForHTN = encodeDisjunctivePreconditionsInMethods && a.prec->isDisjunctive();
+
+	// universal quantifiers that are kept lifted are not expanded, they are added to every instance of the action
+	general_formula* prec = a.prec;
+	general_formula* eff = a.eff;
+
+	// disjunctions of the precondition can be replaced by auxiliary predicates
+	vector<auxiliary_disjunction> auxiliary;
+	if (auxiliary_disjunctions && !disjunctivePreconditionForHTN && prec->isDisjunctive())
+		prec = introduce_auxiliary_disjunctions(prec, a.name, a.arguments->vars, auxiliary);
+	bool auxiliaryPrecondition = auxiliary.size() != 0;
+	set<string> auxiliary_predicates;
+
+	// every auxiliary predicate is made true by an abstract task with one method per disjunct. Their achievers are lowered like any action, s.t. nested disjunctions
+	// get auxiliary predicates of their own
+	for (auxiliary_disjunction & d : auxiliary){
+		out.predicates.push_back(d.predicate);
+		auxiliary_predicates.insert(d.predicate.name);
+
+		task achieve;
+		achieve.name = "__achieve" + d.predicate.name;
+		achieve.vars = d.vars;
+		achieve.number_of_original_vars = achieve.vars.size();
+		achieve.artificial = false;
+		out.add_abstract_task(achieve, true);
+
+		general_formula* atom = new general_formula();
+		atom->type = ATOM;
+		atom->predicate = d.predicate.name;
+		for (auto & [v,_] : d.vars) atom->mutable_arguments().vars.push_back(v);
+
+		for (size_t j = 0; j < d.disjuncts.size(); j++){
+			var_declaration achiever_vars;
+			achiever_vars.vars = d.vars;
+			parsed_task achiever;
+			achiever.name = achieve.name + "_" + to_string(j);
+			achiever.arguments = &achiever_vars;
+			achiever.prec = d.disjuncts[j];
+			achiever.eff = atom;
+			auto [sub, _] = flatten_primitive_task(achiever, compileConditionalEffects, linearConditionalEffectExpansion, encodeDisjunctivePreconditionsInMethods, true, out);
+			if (out.error.size()) return make_pair(task(), true);
+
+			// must start with an underscore s.t. this method is applied by the solution compiler
+			method m;
+			m.name = "_method_for_" + achiever.name;
+			m.at = achieve.name;
+			m.vars = achieve.vars;
+			for (auto & [v,_] : achieve.vars) m.atargs.push_back(v);
+			plan_step ps;
+			ps.id = "id0";
+			ps.task = sub.name;
+			for (auto & v : sub.vars){
+				if (find(m.vars.begin(), m.vars.end(), v) == m.vars.end()) m.vars.push_back(v);
+				ps.args.push_back(v.first);
+			}
+			m.ps.push_back(ps);
+			out.add_method(m, true);
+		}
+	}
+	vector<quantified_literals> forall_prec, forall_eff;
+	additional_variables forall_constants;
+	if (keep_forall_lifted){
+		prec = lift_foralls(prec, false, compileConditionalEffects, forall_prec, forall_constants);
+		eff = lift_foralls(eff, true, compileConditionalEffects, forall_eff, forall_constants);
+	}
 	
-	// expand effects and preconditions (if necessary and possible)
-	vector<pair<pair<vector<variant<literal,conditional_effect>>,vector<literal> >, additional_variables> > elist = a.eff->expand(compileConditionalEffects);
-	vector<pair<pair<vector<variant<literal,conditional_effect>>, vector<literal> >, additional_variables> > plist;
-	if (!disjunctivePreconditionForHTN)	plist = a.prec->expand(false); // precondition cannot contain conditional effects
-	else {
-		pair<pair<vector<variant<literal,conditional_effect>>, vector<literal> >, additional_variables> _temp;
-		plist.push_back(_temp);
+	// expand effects and preconditions (if necessary and possible). The expansions are generated one at a time, s.t. only the tasks have to fit into memory
+	formula_expansion elist(eff, compileConditionalEffects);
+	general_formula noPrecondition;
+	noPrecondition.type = EMPTY;
+	formula_expansion plist(disjunctivePreconditionForHTN ? &noPrecondition : prec, false); // precondition cannot contain conditional effects
+
+	// every combination of effect and precondition becomes an instance of the action
+	if (max_expansion_branches && plist.size() && elist.size() > max_expansion_branches / plist.size()){
+		out.error = "\x1b[31mError\x1b[0m: the action " + a.name + " has " + to_string(elist.size()) + " expansions of its effect and " + to_string(plist.size()) + " of its precondition."
+			+ " More than " + to_string(max_expansion_branches) + " instances are not allowed (see --max-dnf-branches).";
+		return make_pair(task(), true);
 	}
 	
 	// determine whether any expansion has a conditional effect
 	bool expansionHasConditionalEffect = false;
-	if (linearConditionalEffectExpansion)
-		for (auto e : elist)
+	formula_branch e, p;
+	if (linearConditionalEffectExpansion){
+		while (!expansionHasConditionalEffect && elist.next(e))
 			for (auto eff : e.first.first)
 				if (holds_alternative<conditional_effect>(eff))
 					expansionHasConditionalEffect = true;
+		elist.reset();
+	}
 	
 	int i = 0;
 	task mainTask;
 	bool mainTaskIsPrimitive;
-	for(auto e : elist) for(auto p : plist){
+	while (elist.next(e)) for (plist.reset(); plist.next(p);){
 		assert(p.first.second.size() == 0); // precondition cannot contain conditional effects
 		task t; i++;
 		t.name = a.name;
@@ -96,12 +243,16 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 			}
 		}
 
+		t.forall_prec = forall_prec;
+		t.forall_eff = forall_eff;
+
 		// add declared vars
 		t.vars = a.arguments->vars;
 		t.number_of_original_vars = t.vars.size(); // the parsed variables were the original ones
 		// gather the additional variables
 		additional_variables addVars = p.second;
 		for (auto elem : e.second) addVars.insert(elem);
+		for (auto elem : forall_constants) addVars.insert(elem);
 		for (auto v : addVars) {
 			// check whether this variable actually occurs anywhere
 			bool contained = false;
@@ -112,12 +263,13 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 				for (auto cond : ceff.condition)
 					for (auto arg : cond.arguments) contained |= v.first == arg;
 			}
+			contained |= forall_constants.count(v) != 0;
 
 			if (!contained) continue;
 			t.vars.push_back(v);
 		}
 
-		if (plist.size() > 1 || elist.size() > 1 || expansionHasConditionalEffect || disjunctivePreconditionForHTN) {
+		if (plist.size() > 1 || elist.size() > 1 || expansionHasConditionalEffect || disjunctivePreconditionForHTN || auxiliaryPrecondition) {
 			// HELPER FUNCTIONS
 			auto create_predicate_and_literal = [&](string prefix, task ce_at){
 				// build three predicates, one for telling that something has to be checked still
@@ -130,7 +282,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 					argument_predicate.argument_sorts.push_back(v.second);
 					argument_literal.arguments.push_back(v.first);
 				}
-				predicate_definitions.push_back(argument_predicate);
+				out.predicates.push_back(argument_predicate);
 				return make_pair(argument_predicate, argument_literal);
 			};
 			
@@ -168,7 +320,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 					ps.args.push_back(v.first);
 				}
 				m_ce.ps.push_back(ps);
-				methods.push_back(m_ce);
+				out.add_method(m_ce, false);
 			};
 
 			auto create_plan_step = [&](task tt, string prefix){
@@ -187,6 +339,8 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 				t.name += "|ce_base_action";
 			if (disjunctivePreconditionForHTN)
 				t.name += "|disjunctive_prec";
+			if (auxiliaryPrecondition)
+				t.name += "|auxiliary_prec";
 
 			// we have to create a new decomposition method at this point
 			method m;
@@ -198,6 +352,24 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 			// add the starting task as the first one to the method
 			m.ps.push_back(create_plan_step(t,"id_main"));
 
+			if (auxiliaryPrecondition){
+				// the auxiliary predicates of the precondition are achieved right before the action, which deletes them again
+				int k = 0;
+				vector<literal> consumed;
+				for (const literal & l : t.prec) if (auxiliary_predicates.count(l.predicate)){
+					plan_step ps;
+					ps.id = "id_auxiliary_" + to_string(k++);
+					ps.task = "__achieve" + l.predicate;
+					ps.args = l.arguments;
+					m.ordering.push_back(make_pair(ps.id, "id_main"));
+					m.ps.insert(m.ps.end() - 1, ps);
+
+					consumed.push_back(l);
+					consumed.back().positive = false;
+				}
+				t.eff.insert(t.eff.end(), consumed.begin(), consumed.end());
+			}
+
 			
 			if (disjunctivePreconditionForHTN){
 				// the precondition is disjunctive, so we have to check them using the HTN structure
@@ -210,8 +382,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 
 					if (f->type == EMPTY) {
 						method m = create_method(current_task, "__formula_empty_" + to_string(fcounter));
-						m.check_integrity();
-						methods.push_back(m);
+						out.add_method(m, true);
 					} else if (f->type == ATOM || f->type == NOTATOM ||
 							f->type == EQUAL || f->type == NOTEQUAL || 
 							f->type == OFSORT || f->type == NOTOFSORT) {
@@ -227,7 +398,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 								f->equalsLiteral();
 
 						check.prec.push_back(l);
-						addPrimitiveTask(check);
+						out.add_primitive_task(check, false);
 
 						create_singleton_method(current_task, check, "__formula_" + typ + "_" + to_string(fcounter));
 
@@ -243,7 +414,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 									subVars.vars.push_back(var_decl);
 								
 							task subTask = create_task("__formula_or_" + to_string(fcounter) + "_" + to_string(subCounter) + "_", subVars.vars);
-							addAbstractTask(subTask);
+							out.add_abstract_task(subTask, false);
 							
 							// create the method
 							create_singleton_method(current_task,subTask, "__formula_or_" +
@@ -284,15 +455,14 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 
 
 							task subTask = create_task("__formula_forall_" + to_string(fcounter) + "_" + to_string(sub) + "_", sub_vars.vars);
-							addAbstractTask(subTask);
+							out.add_abstract_task(subTask, false);
 							add_to_method_as_last(m,create_plan_step(subTask,"id"+to_string(sub++)));
 
 							// generate an HTN for the subtask
 							generate_formula_HTN(subTask, f->subformulae[0]->copyReplace(replacement), sub_vars);
 						}
 
-						m.check_integrity();
-						methods.push_back(m);
+						out.add_method(m, true);
 					} else if (f->type == AND){
 						method m = create_method(current_task, "__formula_and_" + to_string(fcounter));
 
@@ -306,15 +476,14 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 							
 							
 							task subTask = create_task("__formula_and_" + to_string(fcounter) + "_" + to_string(subCounter) + "_", subVars.vars);
-							addAbstractTask(subTask);
+							out.add_abstract_task(subTask, false);
 							add_to_method_as_last(m,create_plan_step(subTask,"id"+to_string(subCounter++)));
 
 							// generate an HTN for the subtask
 							generate_formula_HTN(subTask, sub, subVars);
 						}
 
-						m.check_integrity();
-						methods.push_back(m);
+						out.add_method(m, true);
 					} else if (f->type == EXISTS){
 						map<string,string> var_replace = f->existsVariableReplacement();
 
@@ -323,7 +492,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 						for (auto & [var,_] : current_vars.vars) existing_variables.insert(var);
 						
 						var_declaration sub_vars = current_vars;
-						for (auto & [qvar,type] : f->qvariables.vars){
+						for (auto & [qvar,type] : f->qvariables().vars){
 							string newVar = var_replace[qvar];
 							if (existing_variables.count(newVar))
 								assert(false);
@@ -334,7 +503,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 						}
 
 						task subTask = create_task("__formula_exists_" + to_string(fcounter) + "_", sub_vars.vars);
-						addAbstractTask(subTask);
+						out.add_abstract_task(subTask, false);
 
 						create_singleton_method(current_task, subTask, "__formula_exists_" + to_string(fcounter) + "_");
 						generate_formula_HTN(subTask, f->subformulae[0]->copyReplace(var_replace), sub_vars);
@@ -356,8 +525,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 
 				// create a carrier task
 				task formula_carrier_root = create_task("__formula-root", initialVariables.vars);
-				formula_carrier_root.check_integrity();
-				addAbstractTask(formula_carrier_root);
+				out.add_abstract_task(formula_carrier_root, true);
 				add_to_method_as_last(m,create_plan_step(formula_carrier_root,"id_prec_root"));
 
 				generate_formula_HTN(formula_carrier_root, a.prec, initialVariables);
@@ -393,8 +561,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 				for (conditional_effect & ceff : t.ceff){
 					/////////// PHASE 1 check conditions
 					task ce_at = create_task("__ce_check_" + to_string(j) + "_", t.vars);
-					ce_at.check_integrity();
-					addAbstractTask(ce_at);						
+					out.add_abstract_task(ce_at, true);						
 					
 					plan_step ce_at_ps = create_plan_step(ce_at, "id_ce_prec_" + to_string(j));
 					add_to_method_as_last(m,ce_at_ps);
@@ -408,8 +575,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 					// additional preconditions
 					main_literal.positive = true;   	ce_yes.prec.push_back(main_literal);
 					apply_literal.positive = true;		ce_yes.eff.push_back(apply_literal);
-					ce_yes.check_integrity();
-					addPrimitiveTask(ce_yes);
+					out.add_primitive_task(ce_yes, true);
 	
 					create_singleton_method(ce_at,ce_yes,"_method_for_ce_yes_");
 				
@@ -422,8 +588,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 						main_literal.positive = true;			ce_no.prec.push_back(main_literal);
 						not_apply_literal.positive = true;		ce_no.eff.push_back(not_apply_literal);
 						// additional preconditions
-						ce_no.check_integrity();
-						addPrimitiveTask(ce_no);
+						out.add_primitive_task(ce_no, true);
 					
 						create_singleton_method(ce_at,ce_no,"_method_for_ce_no_" + to_string(noCount++));
 					}
@@ -431,8 +596,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 
 					/////////// PHASE 2 apply the effect
 					task ce_apply = create_task("__ce_apply_if_applicable_" + to_string(j) + "_", t.vars);
-					ce_apply.check_integrity();
-					addAbstractTask(ce_apply);						
+					out.add_abstract_task(ce_apply, true);						
 					
 					plan_step ce_apply_ps = create_plan_step(ce_apply, "id_ce_eff_" + to_string(j));
 					steps_with_effects.push_back(make_pair(ceff.effect.positive, ce_apply_ps));
@@ -442,16 +606,14 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 														ce_do.eff.push_back(ceff.effect);
 					apply_literal.positive = true;		ce_do.prec.push_back(apply_literal);
 					apply_literal.positive = false;		ce_do.eff.push_back(apply_literal);
-					ce_do.check_integrity();
-					addPrimitiveTask(ce_do);
+					out.add_primitive_task(ce_do, true);
 					create_singleton_method(ce_apply,ce_do,"_method_for_ce_do_apply_");
 
 					// a task that does not applies the effect if necessary
 					task ce_not_do = create_task("__ce_not_apply_" + to_string(j) + "_", t.vars);
 					not_apply_literal.positive = true;	ce_not_do.prec.push_back(not_apply_literal);
 					not_apply_literal.positive = false;	ce_not_do.eff.push_back(not_apply_literal);
-					ce_not_do.check_integrity();
-					addPrimitiveTask(ce_not_do);
+					out.add_primitive_task(ce_not_do, true);
 					create_singleton_method(ce_apply,ce_not_do,"_method_for_ce_not_do_apply_");
 
 
@@ -468,8 +630,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 					main_literal.positive = true;	main_deletes.prec.push_back(main_literal);
 													main_deletes.eff = del_effects;
 					
-					main_deletes.check_integrity();
-					addPrimitiveTask(main_deletes);
+					out.add_primitive_task(main_deletes, true);
 					plan_step main_deletes_ps = create_plan_step(main_deletes, "id_main_del");
 					add_to_method_as_last(m,main_deletes_ps);
 				}
@@ -485,8 +646,7 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 				guard_literal.positive = false;	main_add.eff.push_back(guard_literal);
 				main_literal.positive = false;	main_add.eff.push_back(main_literal);
 				
-				main_add.check_integrity();
-				addPrimitiveTask(main_add);	
+				out.add_primitive_task(main_add, true);	
 				
 				plan_step main_add_ps = create_plan_step(main_add, "id_main_add");
 				add_to_method_as_last(m,main_add_ps);
@@ -499,21 +659,17 @@ pair<task,bool> flatten_primitive_task(parsed_task & a,
 				at.vars = a.arguments->vars;
 				at.number_of_original_vars = at.vars.size();
 				at.artificial = false;
-				at.check_integrity();
-				addAbstractTask(at);
+				out.add_abstract_task(at, true);
 				mainTask = at;
 				mainTaskIsPrimitive = false;
 			}
 			// add to list, moved to if to enable integrity checking
-			t.check_integrity();
-			addPrimitiveTask(t);	
+			out.add_primitive_task(t, true);	
 			
-			m.check_integrity();
-			methods.push_back(m);
+			out.add_method(m, true);
 		} else {
 			// add to list, moved to else to enable integrity checking in if
-			t.check_integrity();
-			addPrimitiveTask(t);	
+			out.add_primitive_task(t, true);	
 			
 			mainTask = t;
 			mainTaskIsPrimitive = true;
@@ -544,35 +700,36 @@ void flatten_tasks(bool compileConditionalEffects,
 	}
 
 	// flatten the primitives ...
-	for(parsed_task & a : parsed_primitive){
-		if (artificialUnitCosts){
-			general_formula * cost_f = new general_formula();
-			cost_f->type = COST;
-			cost_f->predicate = metric_target;
-			
-			general_formula * cost_v = new general_formula();
-			cost_v->type = VALUE;
-			cost_v->value = 1;
-
- 			general_formula * cost_form = new general_formula();
-			cost_form->type=COST_CHANGE;
-			cost_form->subformulae.push_back(cost_f);
-			cost_form->subformulae.push_back(cost_v);
-	
-			general_formula * fullEff = new general_formula();
-			fullEff->type=AND;
-			fullEff->subformulae.push_back(a.eff);
-			fullEff->subformulae.push_back(cost_form);
-
-			a.eff = fullEff;
-		}
-		
-		
+	if (artificialUnitCosts) for(parsed_task & a : parsed_primitive){
+		general_formula * cost_f = new general_formula();
+		cost_f->type = COST;
+		cost_f->predicate = metric_target;
 		
-		flatten_primitive_task(a, compileConditionalEffects, linearConditionalEffectExpansion, encodeDisjunctivePreconditionsInMethods, false);
+		general_formula * cost_v = new general_formula();
+		cost_v->type = VALUE;
+		cost_v->value = 1;
+
+ 		general_formula * cost_form = new general_formula();
+		cost_form->type=COST_CHANGE;
+		cost_form->subformulae.push_back(cost_f);
+		cost_form->subformulae.push_back(cost_v);
 	
+		general_formula * fullEff = new general_formula();
+		fullEff->type=AND;
+		fullEff->subformulae.push_back(a.eff);
+		fullEff->subformulae.push_back(cost_form);
+
+		a.eff = fullEff;
 	}
 
+	vector<lowering_result> results(parsed_primitive.size());
+	lower_in_parallel(parsed_primitive.size(), [&](size_t k){
+			return expansion_needs_order(parsed_primitive[k].prec, false) || expansion_needs_order(parsed_primitive[k].eff, compileConditionalEffects);
+		}, [&](size_t k){
+			flatten_primitive_task(parsed_primitive[k], compileConditionalEffects, linearConditionalEffectExpansion, encodeDisjunctivePreconditionsInMethods, false, results[k]);
+		});
+	add_lowering_results(results);
+
 
 	for(parsed_task & a : parsed_abstract){
 		task at;
@@ -588,8 +745,39 @@ void flatten_tasks(bool compileConditionalEffects,
 void parsed_method_to_data_structures(bool compileConditionalEffects,
 									  bool linearConditionalEffectExpansion,
 									  bool encodeDisjunctivePreconditionsInMethods){
+	vector<pair<string,parsed_method*>> parsed;
+	for (auto & [at, pms] : parsed_methods) for (parsed_method & pm : pms) parsed.push_back(make_pair(at, &pm));
+
+	// new variables are numbered consecutively over all methods. Determine where the numbers of each method start
+	vector<int> first_variable_number;
 	int i = 0;
-	for (auto e : parsed_methods) for (parsed_method pm : e.second) {
+	for (auto & [_, pm] : parsed){
+		first_variable_number.push_back(i);
+		i += 1 + pm->newVarForAT.size();
+		for (sub_task* st : pm->tn->tasks){
+			i += st->arguments->newVar.size();
+			auto psTask = task_name_map.find(st->task);
+			if (psTask == task_name_map.end()){
+				cerr << "There is no declaration of the subtask " << st->task << " in the input" << endl;
+				assert(false);
+			} else if (psTask->second.vars.size() > st->arguments->vars.size())
+				i += psTask->second.vars.size() - st->arguments->vars.size();
+		}
+	}
+
+	if (metric_target == dummy_function_type){
+		metric_target = "method_precondition_cost";
+	}
+
+	vector<lowering_result> results(parsed.size());
+	lower_in_parallel(parsed.size(), [&](size_t k){
+			return expansion_needs_order(parsed[k].second->prec, false) || expansion_needs_order(parsed[k].second->eff, compileConditionalEffects) ||
+				expansion_needs_order(parsed[k].second->tn->constraint, false);
+		}, [&](size_t k){
+		const string & at = parsed[k].first;
+		parsed_method & pm = *parsed[k].second;
+		lowering_result & out = results[k];
+		int i = first_variable_number[k];
 		method m; i++;
 		m.name = pm.name;
 		m.vars = pm.vars->vars;
@@ -602,7 +790,7 @@ void parsed_method_to_data_structures(bool compileConditionalEffects,
 			m.vars.push_back(make_pair(at_arg_additional_vars[av.first],av.second));
 		}
 		// compute arguments of the abstract task
-		m.at = e.first;
+		m.at = at;
 		m.atargs.clear();
 		for (string arg : pm.atArguments){
 			if (at_arg_additional_vars.count(arg))
@@ -629,16 +817,13 @@ void parsed_method_to_data_structures(bool compileConditionalEffects,
 					ps.args.push_back(v);
 
 			// we might have added more parameters to these tasks to account for constants in them. We have to add them here
-			task psTask = task_name_map[ps.task];
-			if (psTask.name != ps.task){
-				cerr << "There is no declaration of the subtask " << ps.task << " in the input" << endl;
-			}
-			assert(psTask.name == ps.task); // ensure that we have found one
-			for (unsigned int j = st->arguments->vars.size(); j < psTask.vars.size(); j++){
-				string v = psTask.vars[j].first + "_method_" + m.name + "_instance_" + to_string(i++);
-				m.vars.push_back(make_pair(v,psTask.vars[j].second)); // add var to set of vars
-				ps.args.push_back(v);
-			}
+			auto psTask = task_name_map.find(ps.task);
+			if (psTask != task_name_map.end())
+				for (unsigned int j = st->arguments->vars.size(); j < psTask->second.vars.size(); j++){
+					string v = psTask->second.vars[j].first + "_method_" + m.name + "_instance_" + to_string(i++);
+					m.vars.push_back(make_pair(v,psTask->second.vars[j].second)); // add var to set of vars
+					ps.args.push_back(v);
+				}
 
 			m.ps.push_back(ps);
 		}
@@ -649,10 +834,6 @@ void parsed_method_to_data_structures(bool compileConditionalEffects,
 		mPrec_task.prec = pm.prec;
 		mPrec_task.arguments = new var_declaration();
 
-		if (metric_target == dummy_function_type){
-			metric_target = "method_precondition_cost";
-		}
-
 		general_formula * cost_f = new general_formula();
 		cost_f->type = COST;
 		cost_f->predicate = metric_target;
@@ -681,20 +862,21 @@ void parsed_method_to_data_structures(bool compileConditionalEffects,
 			if (mPrecVars.count(var.first) || mEffVars.count(var.first))
 				mPrec_task.arguments->vars.push_back(var);
 		
-		auto [mPrec,isPrimitive] = flatten_primitive_task(mPrec_task, compileConditionalEffects, linearConditionalEffectExpansion, encodeDisjunctivePreconditionsInMethods, true);
+		auto [mPrec,isPrimitive] = flatten_primitive_task(mPrec_task, compileConditionalEffects, linearConditionalEffectExpansion, encodeDisjunctivePreconditionsInMethods, true, out);
+		if (out.error.size()) return;
 		mPrec.artificial = true;
 		for (size_t newVar = mPrec_task.arguments->vars.size(); newVar < mPrec.vars.size(); newVar++)
 			m.vars.push_back(mPrec.vars[newVar]);
 
 		// edge case: the precondition might only have contained constraints
-		if (isPrimitive && mPrec.prec.size() == 0 && mPrec.eff.size() == 0 && mPrec.ceff.size() == 0){
+		if (isPrimitive && mPrec.prec.size() == 0 && mPrec.eff.size() == 0 && mPrec.ceff.size() == 0 && mPrec.forall_prec.size() == 0){
 			// has only constraints
 			for (literal l : mPrec.constraints)
 				m.constraints.push_back(l);
 			
 			// remove the task
-			primitive_tasks.pop_back();
-			task_name_map.erase(mPrec.name);
+			out.primitive_tasks.pop_back();
+			out.check_primitive_task.pop_back();
 		} else {
 			// here we actually add the task as a plan step
 			plan_step ps;
@@ -725,284 +907,224 @@ void parsed_method_to_data_structures(bool compileConditionalEffects,
 				assert(false); // constraints cannot contain conditional effects
 
 
-		m.check_integrity();
-		methods.push_back(m);
-	}
+		out.add_method(m, true);
+	});
+	add_lowering_results(results);
 }
 
-void reduce_constraints(){
-	int ns_count = 0;
-	vector<method> oldm = methods;
-	methods.clear();
+// propagates the constraints of a method or task to the domains of its variables until they are arc consistent. Variables whose domain shrinks get a new sort.
+// Constraints that are entailed by the domains are removed. Returns false if the constraints cannot be satisfied
+bool propagate_constraints(vector<pair<string,string>> & vars, vector<literal> & constraints, sort_lattice & lattice, int & ns_count){
+	map<string,id_bitset> domain;
+	// variables whose sort is empty in the input are kept, only domains that become empty by propagation make the constraints unsatisfiable
+	set<string> empty_sort;
+	for (auto & [v,s] : vars){
+		domain[v] = lattice.elements(lattice.sort_set(s));
+		if (domain[v].empty()) empty_sort.insert(v);
+	}
 
-	for (method m : oldm){
-		m.check_integrity();
-		// remove sort constraints
-		vector<literal> oldC = m.constraints;
-		m.constraints.clear();
-		map<string,string> sorts_of_vars; for(auto pp : m.vars) sorts_of_vars[pp.first] = pp.second;
-		for(literal l : oldC) if (l.predicate == dummy_equal_literal) m.constraints.push_back(l); else {
-			// determine the now forbidden variables
-			set<string> currentVals = sorts[sorts_of_vars[l.arguments[0]]];
-			set<string> sortElems = sorts[l.arguments[1]];
-			vector<string> forbidden;
-			if (l.positive) {
-				for (string s : currentVals) if (sortElems.count(s) == 0) forbidden.push_back(s);
+	vector<literal> binary;
+	for (literal l : constraints){
+		if (l.predicate != dummy_equal_literal && l.predicate != dummy_ofsort_literal){
+			cout << "\x1b[31mError\x1b[0m: the constraint " << l.predicate << " is neither an equality nor a sort constraint." << endl;
+			exit(1);
+		}
+		if (l.predicate == dummy_ofsort_literal){
+			// sort constraints: the second argument is a sort
+			id_bitset sortElems = lattice.elements(lattice.sort_set(l.arguments[1]));
+			if (l.arguments[0][0] != '?'){
+				if (l.positive != bitset_contains(sortElems, lattice.constant_id(l.arguments[0]))) return false;
+			} else if (l.positive){
+				id_bitset outside = domain[l.arguments[0]];
+				bitset_subtract(outside, sortElems);
+				bitset_subtract(domain[l.arguments[0]], outside);
 			} else
-				for (string s : sortElems) forbidden.push_back(s);
-			for(string f : forbidden){
-				literal nl;
-				nl.positive = false;
-				nl.predicate = dummy_equal_literal;
-				nl.arguments.push_back(l.arguments[0]);
-				nl.arguments.push_back(f);
-				m.constraints.push_back(nl);
-			}
+				bitset_subtract(domain[l.arguments[0]], sortElems);
+			continue;
 		}
-		m.check_integrity();
-		methods.push_back(m);
-	}
-
-	oldm = methods;
-	methods.clear();
-
-
-	for (method m : oldm){
-		method nm = m;
-		vector<literal> oldC = nm.constraints;
-		nm.constraints.clear();
 
-		bool removeMethod = false;
-		map<string,string> vSort; for (auto x : m.vars) vSort[x.first] = x.second;
-		for (literal l : oldC){
-			if (l.arguments[1][0] == '?' && l.arguments[0][0] != '?'){
-				// ensure that the constant is always the second
-				swap(l.arguments[0],l.arguments[1]);
-			}
+		if (l.arguments[1][0] == '?' && l.arguments[0][0] != '?'){
+			// ensure that the constant is always the second
+			swap(l.arguments[0],l.arguments[1]);
+		}
 
-			if (l.arguments[1][0] != '?' && l.arguments[0][0] != '?'){
+		if (l.arguments[1][0] != '?'){
+			if (l.arguments[0][0] != '?'){
 				// comparing two constants ... well this is a bit stupid, but heck
-				if (l.positive == (l.arguments[0][0] != l.arguments[1][0])){
-					// constraint cannot be satisfied
-					removeMethod = true;
-				}
-				continue;
-			}
-
-
-			if (l.arguments[1][0] == '?'){
-				nm.constraints.push_back(l);
+				if (l.positive != (l.arguments[0] == l.arguments[1])) return false;
 				continue;
 			}
-
-			string v = l.arguments[0];
-			string c = l.arguments[1];
-
-			// v != c and c is not in the sort of v
-			if (!l.positive && !sorts[vSort[v]].count(c)) continue;
-			// recompute sort
-			set<string> vals = sorts[vSort[v]];
+			id_bitset & d = domain[l.arguments[0]];
+			int c = lattice.constant_id(l.arguments[1]);
 			if (l.positive) {
-				if (vals.count(c)) {
-					vals.clear();
-					vals.insert(c);
-				} else vals.clear();
-			} else vals.erase(c);
-			if (vals != sorts[vSort[v]]){
-				string ns = vSort[v] + "_constraint_propagated_" + to_string(++ns_count);
-				vSort[v] = ns;
-				sorts[ns] = vals;
-			}
+				bool contained = bitset_contains(d, c);
+				d.clear();
+				if (contained) bitset_insert(d, c);
+			} else bitset_erase(d, c);
+			continue;
 		}
-		// rebuild args
-		vector<pair<string,string>>	nvar;
-		for (auto x : nm.vars) nvar.push_back(make_pair(x.first,vSort[x.first]));
-		nm.vars = nvar;
-		if (!removeMethod) {
-			nm.check_integrity();
-			methods.push_back(nm);
+
+		if (l.arguments[0] == l.arguments[1]){
+			if (!l.positive) return false;
+			continue;
 		}
+		binary.push_back(l);
 	}
 
-	vector<task> oldt = primitive_tasks;
-	primitive_tasks.clear();
-	for (task t : oldt){
-		task nt = t;
-		vector<literal> oldC = t.constraints;
-		nt.constraints.clear();
-
-		bool removeTask = false;
-		map<string,string> vSort; for (auto x : t.vars) vSort[x.first] = x.second;
-		for (literal l : oldC){
-			if (l.arguments[1][0] == '?' && l.arguments[0][0] != '?'){
-				// ensure that the constant is always the second
-				swap(l.arguments[0],l.arguments[1]);
+	// arc consistency for the constraints between two variables
+	bool changed = true;
+	while (changed){
+		changed = false;
+		for (literal & l : binary){
+			id_bitset & d1 = domain[l.arguments[0]];
+			id_bitset & d2 = domain[l.arguments[1]];
+			if (l.positive){
+				if (d1 == d2) continue;
+				id_bitset both = d1;
+				bitset_subtract(both, d2);
+				bitset_subtract(d1, both);
+				d2 = d1;
+				changed = true;
+			} else {
+				// an inequality only prunes a domain once the other variable has a single value left
+				for (auto [a, b] : {make_pair(&d1, &d2), make_pair(&d2, &d1)})
+					if (bitset_size(*b) == 1 && bitset_intersects(*a, *b)){
+						bitset_subtract(*a, *b);
+						changed = true;
+					}
 			}
+		}
+	}
 
-			if (l.arguments[1][0] != '?' && l.arguments[0][0] != '?'){
-				// comparing two constants ... well this is a bit stupid, but heck
-				if (l.positive == (l.arguments[0][0] != l.arguments[1][0])){
-					// constraint cannot be satisfied
-					removeTask  = true;
-				}
-				continue;
-			}
-			if (l.arguments[1][0] == '?'){
-				nt.constraints.push_back(l);
-				continue;
-			}
+	for (auto & [v,s] : vars) if (domain[v].empty() && !empty_sort.count(v)) return false;
 
-			string v = l.arguments[0];
-			string c = l.arguments[1];
+	constraints.clear();
+	for (literal & l : binary){
+		const id_bitset & d1 = domain[l.arguments[0]];
+		const id_bitset & d2 = domain[l.arguments[1]];
+		bool entailed = l.positive ? bitset_size(d1) == 1 && d1 == d2 : !bitset_intersects(d1, d2);
+		if (!entailed) constraints.push_back(l);
+	}
 
-			// v != c and c is not in the sort of v
-			if (!l.positive && !sorts[vSort[v]].count(c)) continue;
-			// recompute sort
-			set<string> vals = sorts[vSort[v]];
-			if (l.positive) {
-				if (vals.count(c)) {
-					vals.clear();
-					vals.insert(c);
-				} else vals.clear();
-			} else vals.erase(c);
-			if (vals != sorts[vSort[v]]){
-				string ns = vSort[v] + "_constraint_propagated_" + to_string(++ns_count);
-				vSort[v] = ns;
-				sorts[ns] = vals;
-			}
-		}
-		// rebuild args
-		vector<pair<string,string>>	nvar;
-		for (auto x : nt.vars) nvar.push_back(make_pair(x.first,vSort[x.first]));
-		nt.vars = nvar;
-		if (!removeTask) primitive_tasks.push_back(nt);
+	for (auto & [v,s] : vars){
+		int d = lattice.set_id(domain[v]);
+		if (d == lattice.sort_set(s)) continue;
+		string ns = s + "_constraint_propagated_" + to_string(++ns_count);
+		lattice.add_sort(ns, d);
+		s = ns;
 	}
+	return true;
 }
 
-void clean_up_sorts(){
-	// reduce the number of sorts
-	map<set<string>,string> elems_to_sort;
-
-	vector<task> oldt = primitive_tasks;
-	primitive_tasks.clear();
-	for (task t : oldt){
-		task nt = t;
-		vector<pair<string,string>>	nvar;
-		for (auto x : nt.vars) {
-			set<string> elems = sorts[x.second];
-			if (!elems_to_sort.count(elems))
-				elems_to_sort[elems] = x.second;
-			nvar.push_back(make_pair(x.first,elems_to_sort[elems]));
-		}
-		nt.vars = nvar;
-		nt.check_integrity();
-		primitive_tasks.push_back(nt);
+void reduce_constraints(){
+	int ns_count = 0;
+	sort_lattice lattice;
+
+	// methods are propagated first, then the primitive tasks, s.t. the new sorts are numbered in this order
+	vector<bool> satisfiable;
+	for (method & m : methods){
+		m.check_integrity();
+		satisfiable.push_back(propagate_constraints(m.vars, m.constraints, lattice, ns_count));
+		if (satisfiable.back()) m.check_integrity();
 	}
 
-	vector<task> olda = abstract_tasks;
-	abstract_tasks.clear();
-	for (task t : olda){
-		task nt = t;
-		vector<pair<string,string>>	nvar;
-		for (auto x : nt.vars) {
-			set<string> elems = sorts[x.second];
-			if (!elems_to_sort.count(elems))
-				elems_to_sort[elems] = x.second;
-			nvar.push_back(make_pair(x.first,elems_to_sort[elems]));
-		}
-		nt.vars = nvar;
-		nt.check_integrity();
-		abstract_tasks.push_back(nt);
+	// a primitive task whose constraints cannot be satisfied is removed together with all methods that contain it
+	set<string> removedTasks;
+	filter_in_place(primitive_tasks, [&](task & t){
+		if (propagate_constraints(t.vars, t.constraints, lattice, ns_count)) return true;
+		removedTasks.insert(t.name);
+		return false;
+	});
+	for (const string & t : removedTasks) task_name_map.erase(t);
+
+	size_t k = 0;
+	filter_in_place(methods, [&](method & m){
+		if (!satisfiable[k++]) return false;
+		for (const plan_step & ps : m.ps) if (removedTasks.count(ps.task)) return false;
+		return true;
+	});
+}
+
+void clean_up_sorts(){
+	// reduce the number of sorts. All sorts with the same elements are replaced by the first one of them
+	sort_lattice lattice;
+	map<int,string> elems_to_sort;
+	auto representative = [&](const string & sort){
+		int elems = lattice.sort_set(sort);
+		if (!elems_to_sort.count(elems))
+			elems_to_sort[elems] = sort;
+		return elems_to_sort[elems];
+	};
+
+	for (task & t : primitive_tasks){
+		for (auto & x : t.vars) x.second = representative(x.second);
+		for (vector<quantified_literals> * lifted : {&t.forall_prec, &t.forall_eff})
+			for (quantified_literals & q : *lifted)
+				for (auto & x : q.vars) x.second = representative(x.second);
+		t.check_integrity();
 	}
 
-	vector<method> oldm = methods;
-	methods.clear();
-	for (method m : oldm){
-		method nm = m;
-		vector<pair<string,string>>	nvar;
-		for (auto x : nm.vars) {
-			set<string> elems = sorts[x.second];
-			if (!elems_to_sort.count(elems))
-				elems_to_sort[elems] = x.second;
-			nvar.push_back(make_pair(x.first,elems_to_sort[elems]));
-		}
-		nm.vars = nvar;
-		nm.check_integrity();
-		methods.push_back(nm);
+	for (task & t : abstract_tasks){
+		for (auto & x : t.vars) x.second = representative(x.second);
+		t.check_integrity();
 	}
 
-	vector<predicate_definition> opred = predicate_definitions;
-	predicate_definitions.clear();
-	for (auto p : opred){
-		predicate_definition np = p;
-		vector<string>	nvar;
-		for (auto x : np.argument_sorts) {
-			set<string> elems = sorts[x];
-			if (!elems_to_sort.count(elems))
-				elems_to_sort[elems] = x;
-			nvar.push_back(elems_to_sort[elems]);
-		}
-		np.argument_sorts = nvar;
-		predicate_definitions.push_back(np);
+	for (method & m : methods){
+		for (auto & x : m.vars) x.second = representative(x.second);
+		m.check_integrity();
 	}
 
+	for (predicate_definition & p : predicate_definitions)
+		for (string & x : p.argument_sorts) x = representative(x);
+
 	sorts.clear();
-	for (auto x : elems_to_sort)
-		sorts[x.second] = x.first;
+	for (auto & [elems, sort] : elems_to_sort)
+		sorts[sort] = lattice.element_names(elems);
 }
 
 void remove_unnecessary_predicates(){
 	set<string> occuring_preds;
-	for (task t : primitive_tasks) for (literal l : t.prec) occuring_preds.insert(l.predicate);
+	for (const task & t : primitive_tasks) for (const literal & l : t.prec) occuring_preds.insert(l.predicate);
 	// conditions of conditional effects also occur
-	for (task t : primitive_tasks) 
-		for (conditional_effect ceff : t.ceff)
-			for (literal l : ceff.condition)
+	for (const task & t : primitive_tasks) 
+		for (const conditional_effect & ceff : t.ceff)
+			for (const literal & l : ceff.condition)
 				occuring_preds.insert(l.predicate);
+	// as do those of lifted quantifiers
+	for (const task & t : primitive_tasks){
+		for (const quantified_literals & q : t.forall_prec)
+			for (const literal & l : q.literals) occuring_preds.insert(l.predicate);
+		for (const quantified_literals & q : t.forall_eff)
+			for (const literal & l : q.condition) occuring_preds.insert(l.predicate);
+	}
 
-	for (ground_literal gl : goal) occuring_preds.insert(gl.predicate);
-
-	vector<predicate_definition> old = predicate_definitions;
-	predicate_definitions.clear();
-
+	for (const ground_literal & gl : goal) occuring_preds.insert(gl.predicate);
 
 	// find predicates that do not occur in preconditions
 	set<string> removed_predicates;
-	for (predicate_definition p : old){
-		if (occuring_preds.count(p.name)){
-			predicate_definitions.push_back(p);
-		} else
-			removed_predicates.insert(p.name);
-	}
+	filter_in_place(predicate_definitions, [&](predicate_definition & p){
+		if (occuring_preds.count(p.name)) return true;
+		removed_predicates.insert(p.name);
+		return false;
+	});
 
 	// remove these from primitive tasks and the goal
-	vector<task> oldt = primitive_tasks;
-	primitive_tasks.clear();
-	for (task t : oldt){
-		task nt = t;
-		vector<literal> np;
+	for (task & t : primitive_tasks){
 		// filter effects
-		for (literal l: nt.eff)
-			if (!removed_predicates.count(l.predicate))
-				np.push_back(l);
-		nt.eff = np;
-		nt.check_integrity();
-		primitive_tasks.push_back(nt);
+		filter_in_place(t.eff, [&](literal & l){ return !removed_predicates.count(l.predicate); });
+		filter_in_place(t.ceff, [&](conditional_effect & ceff){ return !removed_predicates.count(ceff.effect.predicate); });
+		for (quantified_literals & q : t.forall_eff)
+			filter_in_place(q.literals, [&](literal & l){ return !removed_predicates.count(l.predicate); });
+		filter_in_place(t.forall_eff, [&](quantified_literals & q){ return q.literals.size() != 0; });
+		t.check_integrity();
 	}
 
 	// remove useless predicates from init
-	vector<ground_literal> ni;
-	for (ground_literal l : init)
-		if (!removed_predicates.count(l.predicate))
-			ni.push_back(l);
-	init = ni;
+	for (const string & p : removed_predicates)
+		init.predicates.erase(p);
 
 	// remove useless predicates from goal
-	vector<ground_literal> ng;
-	for (ground_literal l : goal)
-		if (!removed_predicates.count(l.predicate))
-			ng.push_back(l);
-	goal = ng;
+	filter_in_place(goal, [&](ground_literal & l){ return !removed_predicates.count(l.predicate); });
 }
 
 void task::check_integrity(){
@@ -1047,6 +1169,19 @@ void task::check_integrity(){
 		}
 	}
 
+	// lifted quantifiers may also use their own variables
+	for (vector<quantified_literals> * lifted : {&this->forall_prec, &this->forall_eff})
+		for (const quantified_literals & q : *lifted){
+			set<string> known;
+			for (auto & [v,_] : this->vars) known.insert(v);
+			for (auto & [v,_] : q.vars) known.insert(v);
+			for (const vector<literal> * ls : {&q.condition, &q.literals})
+				for (const literal & l : *ls) for (const string & v : l.arguments){
+					if (!known.count(v))
+						cerr << "Task " << this->name << " has the predicate \"" << l.predicate << "\" in a quantified formula, which has the argument \"" << v << "\", which is unknown." << endl;
+					assert(known.count(v));
+				}
+		}
 }
 
 void method::check_integrity(){
@@ -1062,11 +1197,12 @@ void method::check_integrity(){
 	set<string> ids;
 
 	for (plan_step ps : this->ps){
-		assert(task_name_map.count(ps.task));
+		auto t = task_name_map.find(ps.task);
+		assert(t != task_name_map.end());
 		ids.insert(ps.id);
-		task t = task_name_map[ps.task];
-		if (ps.args.size() != t.vars.size()){
-			cerr << "Method " << this->name << " has the subtask (" << ps.id << ") " << ps.task << ". The task is declared with " << t.vars.size() << " parameters, but " << ps.args.size() << " are given in the method." << endl;
+		size_t declared = t == task_name_map.end() ? 0 : t->second.vars.size();
+		if (ps.args.size() != declared){
+			cerr << "Method " << this->name << " has the subtask (" << ps.id << ") " << ps.task << ". The task is declared with " << declared << " parameters, but " << ps.args.size() << " are given in the method." << endl;
 			assert(false);
 		}
 
@@ -1167,10 +1303,10 @@ void method::compute_adj_matrix(){
 void add_consts_to_set(general_formula * f, set<string> & const_set){
 	if (!f) return;
 	if (f->type == EQUAL || f->type == NOTEQUAL){
-		if (f->arg1[0] != '?')
-			const_set.insert(f->arg1);
-		if (f->arg2[0] != '?')
-			const_set.insert(f->arg2);
+		if (f->arg1()[0] != '?')
+			const_set.insert(f->arg1());
+		if (f->arg2()[0] != '?')
+			const_set.insert(f->arg2());
 	}
 
 	for(auto sub : f->subformulae) add_consts_to_set(sub, const_set);
@@ -33,6 +33,14 @@ struct conditional_effect{
 	conditional_effect(vector<literal> cond, literal eff);
 };
 
+// a universally quantified part of a precondition or an effect that is not expanded over the constants of the sorts.
+// The quantified variables are only declared here, all other arguments are variables of the task
+struct quantified_literals{
+	vector<pair<string,string>> vars;
+	vector<literal> condition; // for effects, the condition under which every instance of the literals is made true
+	vector<literal> literals;
+};
+
 struct task{
 	string name;
 	int number_of_original_vars; // the first N variables are original, i.e. exist in the HDDL input file. The rest is artificial and was added by this parser for compilation
@@ -42,6 +50,9 @@ struct task{
 	vector<conditional_effect> ceff;
 	vector<literal> constraints;
 	vector<literal> costExpression;
+	// only used if quantifiers are kept lifted
+	vector<quantified_literals> forall_prec;
+	vector<quantified_literals> forall_eff;
 
 	bool artificial;
 
@@ -89,6 +100,16 @@ extern vector<task> abstract_tasks;
 
 extern map<string, task> task_name_map;
 
+// keeps the elements for which keep (which may change them) returns true. The kept elements are moved, not copied, and stay in their order
+template<class T, class F> void filter_in_place(vector<T> & v, F keep){
+	size_t kept = 0;
+	for (size_t i = 0; i < v.size(); i++) if (keep(v[i])){
+		if (kept != i) v[kept] = move(v[i]);
+		kept++;
+	}
+	v.erase(v.begin() + kept, v.end());
+}
+
 void flatten_tasks(bool compileConditionalEffects, bool linearConditionalEffectExpansion, bool encodeDisjunctivePreconditionsInMethods);
 void parsed_method_to_data_structures(bool compileConditionalEffects, bool linearConditionalEffectExpansion, bool encodeDisjunctivePreconditionsInMethods);
 void reduce_constraints();
@@ -0,0 +1,472 @@
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "domaincache.hpp"
+
+// must be increased whenever the layout of the snapshot or of the parse tree changes
+const uint32_t DOMAIN_CACHE_VERSION = 2;
+const char DOMAIN_CACHE_MAGIC[8] = {'P','A','N','D','A','D','O','M'};
+
+const uint64_t FNV_OFFSET = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+uint64_t fnv1a(const char* data, size_t len, uint64_t h = FNV_OFFSET){
+	for (size_t i = 0; i < len; i++){
+		h ^= (unsigned char) data[i];
+		h *= FNV_PRIME;
+	}
+	return h;
+}
+
+bool domain_cache_key(FILE* domain, string & key){
+	struct stat st;
+	if (fstat(fileno(domain), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+
+	uint64_t h = FNV_OFFSET;
+	size_t size = 0;
+	char buffer[1 << 16];
+	rewind(domain);
+	size_t r;
+	while ((r = fread(buffer, 1, sizeof(buffer), domain)) > 0){
+		h = fnv1a(buffer, r, h);
+		size += r;
+	}
+	bool ok = !ferror(domain);
+	rewind(domain);
+	if (!ok) return false;
+
+	char k[64];
+	snprintf(k, sizeof(k), "%016llx-%zu", (unsigned long long) h, size);
+	key = k;
+	return true;
+}
+
+string snapshot_file_name(const string & dir, const string & key){
+	return dir + "/" + key + ".domain";
+}
+
+
+// serialisation of the parse tree. Pointers are written as ids, s.t. objects that are referenced multiple times are shared after loading as well
+class snapshot_writer{
+	public:
+		string data;
+
+		void put(uint32_t x){ data.append((const char*) &x, sizeof(x)); }
+		void put(int x){ put((uint32_t) x); }
+		void put(bool x){ data.push_back(x ? 1 : 0); }
+		void put(const string & s){ put((uint32_t) s.size()); data.append(s); }
+		void put(const pair<string,string> & p){ put(p.first); put(p.second); }
+		void put(const vector<string> & v){ put((uint32_t) v.size()); for (const string & s : v) put(s); }
+		void put(const set<string> & v){ put((uint32_t) v.size()); for (const string & s : v) put(s); }
+		void put(const additional_variables & v){ put((uint32_t) v.size()); for (auto & p : v) put(p); }
+
+		void put(const var_declaration * v){
+			if (!reference(v)) return;
+			put((uint32_t) v->vars.size());
+			for (auto & p : v->vars) put(p);
+		}
+
+		void put(const var_and_const * v){
+			if (!reference(v)) return;
+			put(v->vars);
+			put(v->newVar);
+		}
+
+		void put(const general_formula * f){
+			if (!reference(f)) return;
+			put((int) f->type);
+			put((uint32_t) f->subformulae.size());
+			for (general_formula * sub : f->subformulae) put((const general_formula*) sub);
+			put(f->predicate);
+			// only the fields of the formula's kind are written
+			put((uint32_t) f->fields_kind());
+			if (f->fields_kind() == 1){
+				put(f->arguments().vars);
+				put(f->arguments().newVar);
+			} else if (f->fields_kind() == 2){
+				put((uint32_t) f->qvariables().vars.size());
+				for (auto & p : f->qvariables().vars) put(p);
+			} else if (f->fields_kind() == 3){
+				put(f->arg1());
+				put(f->arg2());
+			}
+			put(f->value);
+		}
+
+		void put(const sub_task * st){
+			if (!reference(st)) return;
+			put(st->id);
+			put(st->task);
+			put((const var_and_const*) st->arguments);
+		}
+
+		void put(const pair<string,string> * o){
+			if (!reference(o)) return;
+			put(*o);
+		}
+
+		void put(const parsed_task_network * tn){
+			if (!reference(tn)) return;
+			put((uint32_t) tn->tasks.size());
+			for (sub_task * st : tn->tasks) put((const sub_task*) st);
+			put((uint32_t) tn->ordering.size());
+			for (pair<string,string> * o : tn->ordering) put((const pair<string,string>*) o);
+			put((const general_formula*) tn->constraint);
+		}
+
+		void put(const parsed_task & t){
+			put(t.name);
+			put((const var_declaration*) t.arguments);
+			put((const general_formula*) t.prec);
+			put((const general_formula*) t.eff);
+		}
+
+		void put(const parsed_method & m){
+			put(m.name);
+			put(m.atArguments);
+			put((const var_declaration*) m.vars);
+			put(m.newVarForAT);
+			put((const general_formula*) m.prec);
+			put((const general_formula*) m.eff);
+			put((const parsed_task_network*) m.tn);
+		}
+
+		void put(const predicate_definition & p){
+			put(p.name);
+			put(p.argument_sorts);
+		}
+
+	private:
+		map<const void*, uint32_t> ids;
+
+		// writes the id of the object, returns true if the object itself has to be written
+		bool reference(const void* p){
+			if (p == NULL) { put((uint32_t) 0); return false; }
+			auto it = ids.find(p);
+			if (it != ids.end()) { put(it->second); return false; }
+			uint32_t id = ids.size() + 1;
+			ids[p] = id;
+			put(id);
+			return true;
+		}
+};
+
+class snapshot_reader{
+	public:
+		bool ok = true;
+
+		snapshot_reader(const char* data, size_t size) : pos(data), end(data + size) {}
+
+		bool at_end(){ return pos == end; }
+
+		void get(uint32_t & x){
+			if (!check(sizeof(x))) { x = 0; return; }
+			memcpy(&x, pos, sizeof(x));
+			pos += sizeof(x);
+		}
+		void get(int & x){ uint32_t u; get(u); x = (int) u; }
+		void get(bool & x){ x = check(1) && *pos++; }
+		void get(string & s){
+			uint32_t len; get(len);
+			if (!check(len)) return;
+			s.assign(pos, len);
+			pos += len;
+		}
+		void get(pair<string,string> & p){ get(p.first); get(p.second); }
+		void get(vector<string> & v){
+			uint32_t n; get(n);
+			for (uint32_t i = 0; ok && i < n; i++) { string s; get(s); v.push_back(s); }
+		}
+		void get(set<string> & v){
+			uint32_t n; get(n);
+			for (uint32_t i = 0; ok && i < n; i++) { string s; get(s); v.insert(s); }
+		}
+		void get(additional_variables & v){
+			uint32_t n; get(n);
+			for (uint32_t i = 0; ok && i < n; i++) { pair<string,string> p; get(p); v.insert(p); }
+		}
+
+		void get(var_declaration* & v){
+			if (!reference(v)) return;
+			uint32_t n; get(n);
+			for (uint32_t i = 0; ok && i < n; i++) { pair<string,string> p; get(p); v->vars.push_back(p); }
+		}
+
+		void get(var_and_const* & v){
+			if (!reference(v)) return;
+			get(v->vars);
+			get(v->newVar);
+		}
+
+		void get(general_formula* & f){
+			if (!reference(f)) return;
+			int type; get(type);
+			f->type = (formula_type) type;
+			uint32_t n; get(n);
+			for (uint32_t i = 0; ok && i < n; i++) { general_formula* sub; get(sub); f->subformulae.push_back(sub); }
+			get(f->predicate);
+			uint32_t kind; get(kind);
+			if (kind == 1){
+				get(f->mutable_arguments().vars);
+				get(f->mutable_arguments().newVar);
+			} else if (kind == 2){
+				get(n);
+				for (uint32_t i = 0; ok && i < n; i++) { pair<string,string> p; get(p); f->mutable_qvariables().vars.push_back(p); }
+			} else if (kind == 3){
+				get(f->mutable_args().first);
+				get(f->mutable_args().second);
+			} else if (kind != 0) ok = false;
+			get(f->value);
+		}
+
+		void get(sub_task* & st){
+			if (!reference(st)) return;
+			get(st->id);
+			get(st->task);
+			get(st->arguments);
+		}
+
+		void get(pair<string,string>* & o){
+			if (!reference(o)) return;
+			get(*o);
+		}
+
+		void get(parsed_task_network* & tn){
+			if (!reference(tn)) return;
+			uint32_t n; get(n);
+			for (uint32_t i = 0; ok && i < n; i++) { sub_task* st; get(st); tn->tasks.push_back(st); }
+			get(n);
+			for (uint32_t i = 0; ok && i < n; i++) { pair<string,string>* o; get(o); tn->ordering.push_back(o); }
+			get(tn->constraint);
+		}
+
+		void get(parsed_task & t){
+			get(t.name);
+			get(t.arguments);
+			get(t.prec);
+			get(t.eff);
+		}
+
+		void get(parsed_method & m){
+			get(m.name);
+			get(m.atArguments);
+			get(m.vars);
+			get(m.newVarForAT);
+			get(m.prec);
+			get(m.eff);
+			get(m.tn);
+		}
+
+		void get(predicate_definition & p){
+			get(p.name);
+			get(p.argument_sorts);
+		}
+
+	private:
+		const char* pos;
+		const char* end;
+		vector<void*> objects;
+
+		bool check(size_t len){
+			if (ok && size_t(end - pos) >= len) return true;
+			ok = false;
+			return false;
+		}
+
+		// reads the id of an object, returns true if the object is new and its contents have to be read
+		template<class T> bool reference(T* & p){
+			p = NULL;
+			uint32_t id; get(id);
+			if (!ok || id == 0) return false;
+			if (id <= objects.size()) { p = (T*) objects[id - 1]; return false; }
+			if (id != objects.size() + 1) { ok = false; return false; }
+			p = new T();
+			objects.push_back(p);
+			return true;
+		}
+};
+
+
+struct snapshot_header{
+	char magic[8];
+	uint32_t version;
+	uint32_t payload_hash_low;
+	uint32_t payload_hash_high;
+	uint32_t payload_size;
+};
+
+void store_domain_cache(const string & dir, const string & key, const parse_context & ctx){
+	// a domain has neither an initial state nor a goal. Don't cache anything if this one has
+	if (ctx.init.size() || ctx.init_functions.size() || ctx.goal_formula) return;
+
+	snapshot_writer w;
+	w.put(ctx.has_typeof_predicate);
+	w.put(ctx.sort_object_needed);
+
+	w.put((uint32_t) ctx.sort_definitions.size());
+	for (const sort_definition & s : ctx.sort_definitions){
+		w.put(s.declared_sorts);
+		w.put(s.has_parent_sort);
+		w.put(s.parent_sort);
+	}
+	w.put((uint32_t) ctx.predicate_definitions.size());
+	for (const predicate_definition & p : ctx.predicate_definitions) w.put(p);
+	w.put((uint32_t) ctx.parsed_primitive.size());
+	for (const parsed_task & t : ctx.parsed_primitive) w.put(t);
+	w.put((uint32_t) ctx.parsed_abstract.size());
+	for (const parsed_task & t : ctx.parsed_abstract) w.put(t);
+	w.put((uint32_t) ctx.parsed_methods.size());
+	for (auto & [at, ms] : ctx.parsed_methods){
+		w.put(at);
+		w.put((uint32_t) ms.size());
+		for (const parsed_method & m : ms) w.put(m);
+	}
+	w.put((uint32_t) ctx.parsed_functions.size());
+	for (auto & [f, type] : ctx.parsed_functions){
+		w.put(f);
+		w.put(type);
+	}
+	w.put(ctx.metric_target);
+	// constants declared in the domain
+	w.put((uint32_t) ctx.sorts.size());
+	for (auto & [s, elems] : ctx.sorts){
+		w.put(s);
+		w.put(elems);
+	}
+
+	uint64_t h = fnv1a(w.data.data(), w.data.size());
+	snapshot_header header;
+	memcpy(header.magic, DOMAIN_CACHE_MAGIC, sizeof(header.magic));
+	header.version = DOMAIN_CACHE_VERSION;
+	header.payload_hash_low = h;
+	header.payload_hash_high = h >> 32;
+	header.payload_size = w.data.size();
+
+	// write into a temporary file first, s.t. concurrent runs never see a partial snapshot
+#ifdef _WIN32
+	if (_mkdir(dir.c_str()) != 0 && errno != EEXIST) return;
+	string file = snapshot_file_name(dir, key);
+	string tmp = file + ".tmp." + to_string(_getpid());
+#else
+	if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) return;
+	string file = snapshot_file_name(dir, key);
+	string tmp = file + ".tmp." + to_string(getpid());
+#endif
+	FILE* out = fopen(tmp.c_str(), "wb");
+	if (!out) return;
+	bool written = fwrite(&header, sizeof(header), 1, out) == 1 && fwrite(w.data.data(), 1, w.data.size(), out) == w.data.size();
+	written = (fclose(out) == 0) && written;
+	if (!written || rename(tmp.c_str(), file.c_str()) != 0) remove(tmp.c_str());
+}
+
+bool read_snapshot(snapshot_reader & r, parse_context & ctx){
+	r.get(ctx.has_typeof_predicate);
+	r.get(ctx.sort_object_needed);
+
+	uint32_t n;
+	r.get(n);
+	for (uint32_t i = 0; r.ok && i < n; i++){
+		sort_definition s;
+		r.get(s.declared_sorts);
+		r.get(s.has_parent_sort);
+		r.get(s.parent_sort);
+		ctx.sort_definitions.push_back(s);
+	}
+	r.get(n);
+	for (uint32_t i = 0; r.ok && i < n; i++) { predicate_definition p; r.get(p); ctx.predicate_definitions.push_back(p); }
+	r.get(n);
+	for (uint32_t i = 0; r.ok && i < n; i++) { parsed_task t; r.get(t); ctx.parsed_primitive.push_back(t); }
+	r.get(n);
+	for (uint32_t i = 0; r.ok && i < n; i++) { parsed_task t; r.get(t); ctx.parsed_abstract.push_back(t); }
+	r.get(n);
+	for (uint32_t i = 0; r.ok && i < n; i++){
+		string at; r.get(at);
+		uint32_t m; r.get(m);
+		vector<parsed_method> & ms = ctx.parsed_methods[at];
+		for (uint32_t j = 0; r.ok && j < m; j++) { parsed_method pm; r.get(pm); ms.push_back(pm); }
+	}
+	r.get(n);
+	for (uint32_t i = 0; r.ok && i < n; i++){
+		pair<predicate_definition,string> f;
+		r.get(f.first);
+		r.get(f.second);
+		ctx.parsed_functions.push_back(f);
+	}
+	r.get(ctx.metric_target);
+	r.get(n);
+	for (uint32_t i = 0; r.ok && i < n; i++){
+		string s; r.get(s);
+		r.get(ctx.sorts[s]);
+	}
+
+	return r.ok && r.at_end();
+}
+
+bool load_domain_cache(const string & dir, const string & key, parse_context & ctx){
+#ifdef _WIN32
+	// without mmap, the snapshot is read into memory
+	FILE* f = fopen(snapshot_file_name(dir, key).c_str(), "rb");
+	if (!f) return false;
+	vector<char> buffer;
+	char block[1 << 16];
+	size_t r;
+	while ((r = fread(block, 1, sizeof(block), f)) > 0) buffer.insert(buffer.end(), block, block + r);
+	fclose(f);
+	size_t size = buffer.size();
+	if (size < sizeof(snapshot_header)) return false;
+	const char* data = buffer.data();
+#else
+	int fd = open(snapshot_file_name(dir, key).c_str(), O_RDONLY);
+	if (fd == -1) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(snapshot_header)){
+		close(fd);
+		return false;
+	}
+	size_t size = st.st_size;
+	void* m = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (m == MAP_FAILED) return false;
+	const char* data = (const char*) m;
+#endif
+	snapshot_header header;
+	memcpy(&header, data, sizeof(header));
+	bool ok = memcmp(header.magic, DOMAIN_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+		header.version == DOMAIN_CACHE_VERSION &&
+		header.payload_size == size - sizeof(header);
+	if (ok){
+		uint64_t h = fnv1a(data + sizeof(header), header.payload_size);
+		ok = header.payload_hash_low == uint32_t(h) && header.payload_hash_high == uint32_t(h >> 32);
+	}
+	if (ok){
+		snapshot_reader r(data + sizeof(header), header.payload_size);
+		ok = read_snapshot(r, ctx);
+	}
+#ifndef _WIN32
+	munmap(m, size);
+#endif
+
+	if (!ok){
+		// a broken snapshot is ignored. The domain is simply parsed again
+		ctx.has_typeof_predicate = ctx.sort_object_needed = false;
+		ctx.sort_definitions.clear();
+		ctx.predicate_definitions.clear();
+		ctx.parsed_primitive.clear();
+		ctx.parsed_abstract.clear();
+		ctx.parsed_methods.clear();
+		ctx.parsed_functions.clear();
+		ctx.metric_target = dummy_function_type;
+		ctx.sorts.clear();
+	}
+	return ok;
+}
@@ -0,0 +1,19 @@
+#ifndef __DOMAINCACHE
+#define __DOMAINCACHE
+
+#include <cstdio>
+#include <string>
+#include "parser.hpp"
+
+using namespace std;
+
+// The parse of a domain file can be stored in a cache directory. Snapshots are keyed by a hash of the domain file's contents, s.t. runs with the same domain but different problems only parse the domain once.
+
+// key of the domain file in the cache. Returns false if the file cannot be hashed (e.g. it is a pipe)
+bool domain_cache_key(FILE* domain, string & key);
+// reads the snapshot for the key into the context. Returns false if there is no usable snapshot
+bool load_domain_cache(const string & dir, const string & key, parse_context & ctx);
+// writes the snapshot of the context. Failing to write the cache is not an error
+void store_domain_cache(const string & dir, const string & key, const parse_context & ctx);
+
+#endif
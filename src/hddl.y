@@ -2,37 +2,57 @@
 	#include <cstdio>
 	#include <iostream>
 	#include <vector>
+	#include <thread>
 	#include <cassert>
 	#include <string.h>
 	#include <algorithm>
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#ifndef _WIN32
+	#include <sys/mman.h>
+	#include <unistd.h>
+	#endif
 	#include "parsetree.hpp"
 	#include "domain.hpp"
 	#include "cwa.hpp"
+	#include "parser.hpp"
+	#include "domaincache.hpp"
+	#include "chunkparser.hpp"
 	
 	using namespace std;
-	
+%}
+
+%code requires {
+	// the scanner is reentrant, its state is passed around as an opaque pointer
+	typedef void* yyscan_t;
+	struct parse_context;
+}
+
+%code {
 	// Declare stuff from Flex that Bison needs to know about:
-	extern int yylex();
-	extern int yyparse();
-	extern FILE *yyin;
-	char* current_parser_file_name;
-	
-	void yyerror(const char *s);
+	int yylex(YYSTYPE* yylval_param, YYLTYPE* yylloc_param, yyscan_t scanner);
+	int yylex_init_extra(parse_context* ctx, yyscan_t* scanner);
+	void yyset_in(FILE* f, yyscan_t scanner);
+	int yylex_destroy(yyscan_t scanner);
+	struct yy_buffer_state* yy_scan_buffer(char* base, size_t size, yyscan_t scanner);
+	void yy_delete_buffer(struct yy_buffer_state* buffer, yyscan_t scanner);
+
+	void yyerror(YYLTYPE* loc, yyscan_t scanner, parse_context* ctx, const char *s);
+}
 
-	bool sortObjectNeeded = false;
-%}
+%define api.pure full
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {parse_context* ctx}
 
 %locations
 %define parse.error verbose
 %define parse.lac full
 
-%locations
-
 %union {
 	bool bval;
 	int ival;
 	float fval;
-	char *sval;
+	const char *sval;
 	std::vector<std::string>* vstring;
 	var_declaration* vardecl;
 	predicate_definition* preddecl;
@@ -57,7 +77,7 @@
 %token <fval> FLOAT
 %token <ival> INT
 
-%type <sval> var_or_const
+%type <sval> var_or_const init_atom
 %type <sval> typed_function_list_continuation 
 %type <bval> task_or_action
 %type <vstring> NAME-list NAME-list-non-empty 
@@ -141,32 +161,39 @@ problem_defs: problem_defs require_def |
 
 p_object_declaration : '(' KEY_OBJECTS constant_declaration_list ')';
 p_init : '(' KEY_INIT init_el ')';
-init_el : init_el literal {
-		if ($2->type != NOTATOM){ // just ignore not in the initial state
-			assert($2->type == ATOM);
-			map<string,string> access;
-			// for each constant a new sort with a uniq name has been created. We access it here and retrieve its only element, the constant in questions
-			for(auto x : $2->arguments.newVar) access[x.first] = *sorts[x.second].begin();  
-			ground_literal l;
-			l.positive = true;
-			l.predicate = $2->predicate;
-			for(string v : $2->arguments.vars) l.args.push_back(access[v]);
-			init.push_back(l);
-		}
+init_el : init_el init_atom {
+		auto it = ctx->init_predicates.find($2);
+		if (it == ctx->init_predicates.end()) it = ctx->init_predicates.emplace($2, &ctx->init.predicates[$2]).first;
+		it->second->add(true, ctx->init_args);
 	} |
+	init_el '(' KEY_NOT init_atom ')' | // just ignore not in the initial state
 	init_el '(' '=' literal INT ')' {
 		assert($4->type == ATOM);
 		map<string,string> access;
 		// for each constant a new sort with a uniq name has been created. We access it here and retrieve its only element, the constant in questions
-		for(auto x : $4->arguments.newVar) access[x.first] = *sorts[x.second].begin();
+		for(auto x : $4->arguments().newVar) access[x.first] = *ctx->sorts[x.second].begin();
 		ground_literal l;
 		l.positive = true;
 		l.predicate = $4->predicate;
-		for(string v : $4->arguments.vars) l.args.push_back(access[v]);
-		init_functions.push_back(std::make_pair(l,$5));
+		for(string v : $4->arguments().vars) l.args.push_back(access[v]);
+		ctx->init_functions.push_back(std::make_pair(l,$5));
 	} |
 
-p_goal : '(' KEY_GOAL gd ')' {goal_formula = $3;}
+// facts are not turned into formulae, their constants are collected in ctx->init_args
+init_atom : '(' NAME init_constant-list ')' {$$ = $2;}
+init_constant-list : init_constant-list NAME {
+		auto it = ctx->init_constant_ids.find($2);
+		if (it == ctx->init_constant_ids.end()){
+			string c($2);
+			// like for constants in formulae, a sort containing only this constant is created
+			ctx->sorts["sort_for_" + c].insert(c);
+			it = ctx->init_constant_ids.emplace($2, ctx->init.constant_id(c)).first;
+		}
+		ctx->init_args.push_back(it->second);
+	}
+	| {ctx->init_args.clear();}
+
+p_goal : '(' KEY_GOAL gd ')' {ctx->goal_formula = $3;}
 
 htn_type: KEY_HTN | KEY_TIHTN {assert(false); /*we don't support ti-htn yet*/}
 parameters-option: KEY_PARAMETERS '(' typed_or_untyped_var_list ')' {$$ = $3;} | {$$ = new var_declaration(); }
@@ -181,14 +208,14 @@ p_htn : '(' htn_type
 		m.prec = new general_formula(); m.prec->type = EMPTY;
 		m.eff = new general_formula(); m.eff->type = EMPTY;
 		m.tn = $4;
-		parsed_methods[atName].push_back(m);
+		ctx->parsed_methods[atName].push_back(m);
 
 		parsed_task	top;
 		top.name = "__top";
 		top.arguments = new var_declaration();
 		top.prec = new general_formula(); top.prec->type = EMPTY;
 		top.eff = new general_formula(); top.eff->type = EMPTY;
-		parsed_abstract.push_back(top);
+		ctx->parsed_abstract.push_back(top);
 }
 
 p_constraint : '(' KEY_CONSTRAINTS gd ')'
@@ -196,8 +223,8 @@ p_constraint : '(' KEY_CONSTRAINTS gd ')'
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // Cost metric
 p_metric : '(' KEY_METRIC KEY_MIMIZE metric_f_exp ')' 
-metric_f_exp : NAME { metric_target = $1; }
-metric_f_exp : '(' NAME ')' { metric_target = $2; }
+metric_f_exp : NAME { ctx->metric_target = $1; }
+metric_f_exp : '(' NAME ')' { ctx->metric_target = $2; }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // Final state utilities for over subscription planning
@@ -218,31 +245,31 @@ domain_symbol : NAME
 // Requirement Statement
 // @PDDL
 require_def : '(' KEY_REQUIREMENTS require_defs ')'
-require_defs : require_defs REQUIRE_NAME {string r($2); if (r == ":typeof-predicate") has_typeof_predicate = true; } | 
+require_defs : require_defs REQUIRE_NAME {string r($2); if (r == ":typeof-predicate") ctx->has_typeof_predicate = true; } | 
 
 
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // Type Definition
 // @PDDL
-type_def : '(' KEY_TYPES type_def_list ')' { /*reverse list after all types have been parsed*/ reverse(sort_definitions.begin(), sort_definitions.end()); };
+type_def : '(' KEY_TYPES type_def_list ')' { /*reverse list after all types have been parsed*/ reverse(ctx->sort_definitions.begin(), ctx->sort_definitions.end()); };
 type_def_list : | 
 			  NAME-list-non-empty {	sort_definition s; s.has_parent_sort = false; s.declared_sorts = *($1); delete $1;
 			  				if (s.declared_sorts.size()) {
-								sort_definitions.push_back(s);
+								ctx->sort_definitions.push_back(s);
 								// touch constant map to ensure a consistent access
 								for (string & ss : s.declared_sorts) {
-									sorts[ss].size();
+									ctx->sorts[ss].size();
 								}
 							}
 				}
 			  | NAME-list-non-empty '-' NAME type_def_list {
-							sort_definition s; s.has_parent_sort = true; s.parent_sort = $3; free($3);
+							sort_definition s; s.has_parent_sort = true; s.parent_sort = $3;
 							s.declared_sorts = *($1); delete $1;
-			  				sort_definitions.push_back(s);
+			  				ctx->sort_definitions.push_back(s);
 							// touch constant map to ensure a consistent access
-							for (string & ss : s.declared_sorts) sorts[ss].size();
-							sorts[s.parent_sort].size();
+							for (string & ss : s.declared_sorts) ctx->sorts[ss].size();
+							ctx->sorts[s.parent_sort].size();
 							}
 
 
@@ -254,13 +281,13 @@ const_def : '(' KEY_CONSTANTS constant_declaration_list ')'
 constant_declaration_list : 
 						  | NAME-list-non-empty {
 							for(unsigned int i = 0; i < $1->size(); i++)
-								sorts["object"].insert((*($1))[i]);
-							sortObjectNeeded = true;
+								ctx->sorts["object"].insert((*($1))[i]);
+							ctx->sort_object_needed = true;
 						}
 						  | NAME-list-non-empty '-' NAME constant_declaration_list_with_type {
 							string type($3);
 							for(unsigned int i = 0; i < $1->size(); i++){
-								sorts[type].insert((*($1))[i]);
+								ctx->sorts[type].insert((*($1))[i]);
 							}
 						}
 
@@ -270,7 +297,7 @@ constant_declaration_list_with_type : constant_declaration_list_with_type consta
 constant_declarations : NAME-list-non-empty '-' NAME {
 						string type($3);
 						for(unsigned int i = 0; i < $1->size(); i++){
-							sorts[type].insert((*($1))[i]);
+							ctx->sorts[type].insert((*($1))[i]);
 						}
 }
 
@@ -279,7 +306,7 @@ constant_declarations : NAME-list-non-empty '-' NAME {
 // @PDDL
 predicates_def : '(' KEY_PREDICATES atomic_predicate_def-list ')'
 
-atomic_predicate_def-list : atomic_predicate_def-list atomic_predicate_def {predicate_definitions.push_back(*($2)); delete $2;} | 
+atomic_predicate_def-list : atomic_predicate_def-list atomic_predicate_def {ctx->predicate_definitions.push_back(*($2)); delete $2;} | 
 atomic_predicate_def : '(' NAME typed_or_untyped_var_list  ')' {
 		$$ = new predicate_definition();
 		$$->name = $2;
@@ -292,14 +319,14 @@ atomic_predicate_def : '(' NAME typed_or_untyped_var_list  ')' {
 functions_def : '(' KEY_FUNCTIONS typed_atomic_function_def-list ')'
 
 typed_atomic_function_def-list : atomic_function_def-list typed_function_list_continuation {
-	char * type_of_functions = $2;
+	const char * type_of_functions = $2;
 	for (predicate_definition* p : *$1){
-		parsed_functions.push_back(std::make_pair(*p,type_of_functions));
+		ctx->parsed_functions.push_back(std::make_pair(*p,type_of_functions));
 		delete p;
 	}
 	delete $1;
 }
-typed_function_list_continuation : '-' NAME typed_atomic_function_def-list { $$ = $2; } | { $$ = strdup(numeric_funtion_type.c_str()); }
+typed_function_list_continuation : '-' NAME typed_atomic_function_def-list { $$ = $2; } | { $$ = ctx->symbols.intern(numeric_funtion_type.c_str(), numeric_funtion_type.size()); }
 
 atomic_function_def-list : atomic_function_def-list atomic_predicate_def { $$->push_back($2); } | { $$ = new std::vector<predicate_definition*>();}
 
@@ -323,7 +350,7 @@ task_def : '(' task_or_action NAME
 				t.prec = $5; 
 				t.eff = $6;
 
-				if ($2) parsed_abstract.push_back(t); else parsed_primitive.push_back(t);
+				if ($2) ctx->parsed_abstract.push_back(t); else ctx->parsed_primitive.push_back(t);
 }
 
 precondition_option: KEY_PRECONDITION gd {$$ = $2;} | {$$ = new general_formula(); $$->type = EMPTY;}
@@ -354,7 +381,7 @@ method_def :
 		m.eff = $11;
 		m.tn = $12;
 
-		parsed_methods[atName].push_back(m);
+		ctx->parsed_methods[atName].push_back(m);
 	}
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -412,7 +439,7 @@ subtask_defs : '(' ')' {$$ = new vector<sub_task*>();}
 			  | '(' KEY_AND subtask_def-list ')' {$$ = $3;}
 subtask_def-list : subtask_def-list subtask_def {$$ = $1; $$->push_back($2);}
 				 | {$$ = new vector<sub_task*>();}
-subtask_def :	'(' NAME var_or_const-list ')' {$$ = new sub_task(); $$->id = "__t_id_" + to_string(task_id_counter); task_id_counter++; $$->task = $2; $$->arguments = $3; }
+subtask_def :	'(' NAME var_or_const-list ')' {$$ = new sub_task(); $$->id = "__t_id_" + to_string(ctx->task_id_counter); ctx->task_id_counter++; $$->task = $2; $$->arguments = $3; }
 			  | '(' NAME '(' NAME var_or_const-list ')' ')' {$$ = new sub_task(); $$->id = $2; $$->task = $4; $$->arguments = $5; }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -438,10 +465,10 @@ constraint_def-list: constraint_def-list constraint_def {$$ = $1; $$->push_back(
 				    | {$$ = new vector<general_formula*>();}
 constraint_def : '(' ')' {$$ = new general_formula(); $$->type = EMPTY;}
 				| '(' KEY_AND constraint_def-list ')' {$$ = new general_formula(); $$->type=AND; $$->subformulae = *($3);}
-				| '(' '=' var_or_const var_or_const ')' {$$ = new general_formula(); $$->type = EQUAL; $$->arg1 = $3; $$->arg2 = $4;}
-				| '(' KEY_NOT '(' '=' var_or_const var_or_const ')' ')' {$$ = new general_formula(); $$->type = NOTEQUAL; $$->arg1 = $5; $$->arg2 = $6;}
-                | '(' KEY_TYPEOF typed_var ')' {$$ = new general_formula(); $$->type = OFSORT; $$->arg1 = $3->vars[0].first; $$->arg2 = $3->vars[0].second; }
-                | '(' KEY_NOT '(' KEY_TYPEOF typed_var ')' ')'  {$$ = new general_formula(); $$->type = NOTOFSORT; $$->arg1 = $5->vars[0].first; $$->arg2 = $5->vars[0].second; }
+				| '(' '=' var_or_const var_or_const ')' {$$ = new general_formula(); $$->type = EQUAL; $$->mutable_args() = {$3, $4};}
+				| '(' KEY_NOT '(' '=' var_or_const var_or_const ')' ')' {$$ = new general_formula(); $$->type = NOTEQUAL; $$->mutable_args() = {$5, $6};}
+                | '(' KEY_TYPEOF typed_var ')' {$$ = new general_formula(); $$->type = OFSORT; $$->mutable_args() = {$3->vars[0].first, $3->vars[0].second}; }
+                | '(' KEY_NOT '(' KEY_TYPEOF typed_var ')' ')'  {$$ = new general_formula(); $$->type = NOTOFSORT; $$->mutable_args() = {$5->vars[0].first, $5->vars[0].second}; }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // Causal Links
@@ -474,14 +501,14 @@ gd_conjuction : '(' KEY_AND gd-list ')' {$$ = new general_formula(); $$->type=AN
 gd_disjuction : '(' KEY_OR gd-list ')' {$$ = new general_formula(); $$->type=OR; $$->subformulae = *($3);}
 gd_negation : '(' KEY_NOT gd ')' {$$ = $3; $$->negate();}
 gd_implication : '(' KEY_IMPLY gd gd ')' {$$ = new general_formula(); $$->type=OR; $3->negate(); $$->subformulae.push_back($3); $$->subformulae.push_back($4);}
-gd_existential : '(' KEY_EXISTS '(' typed_or_untyped_var_list  ')' gd ')' {$$ = new general_formula(); $$->type = EXISTS; $$->subformulae.push_back($6); $$->qvariables = *($4);} 
-gd_universal : '(' KEY_FORALL '(' typed_or_untyped_var_list  ')' gd ')' {$$ = new general_formula(); $$->type = FORALL; $$->subformulae.push_back($6); $$->qvariables = *($4);} 
-gd_equality_constraint : '(' '=' var_or_const var_or_const ')' {$$ = new general_formula(); $$->type = EQUAL; $$->arg1 = $3; $$->arg2 = $4;}
+gd_existential : '(' KEY_EXISTS '(' typed_or_untyped_var_list  ')' gd ')' {$$ = new general_formula(); $$->type = EXISTS; $$->subformulae.push_back($6); $$->mutable_qvariables() = *($4);} 
+gd_universal : '(' KEY_FORALL '(' typed_or_untyped_var_list  ')' gd ')' {$$ = new general_formula(); $$->type = FORALL; $$->subformulae.push_back($6); $$->mutable_qvariables() = *($4);} 
+gd_equality_constraint : '(' '=' var_or_const var_or_const ')' {$$ = new general_formula(); $$->type = EQUAL; $$->mutable_args() = {$3, $4};}
 
 var_or_const-list :   var_or_const-list NAME {
 						$$ = $1;
 						string c($2); string s = "sort_for_" + c; string v = "?var_for_" + c;
-						sorts[s].insert(c);
+						ctx->sorts[s].insert(c);
 						$$->vars.push_back(v);
 						$$->newVar.insert(make_pair(v,s));
 					}
@@ -490,7 +517,7 @@ var_or_const-list :   var_or_const-list NAME {
 
 var_or_const : NAME {$$=$1;}| VAR_NAME {$$=$1;}
 atomic_formula : '('NAME var_or_const-list')' {$$ = new general_formula(); $$->type=ATOM;
-			   								   $$->predicate = $2; $$->arguments = *($3);
+			   								   $$->predicate = $2; $$->mutable_arguments() = *($3);
 											  }
 
 
@@ -512,7 +539,7 @@ effect : eff_empty {$$ = $1;}
 
 eff_empty : '(' ')' {$$ = new general_formula(); $$->type=EMPTY;}
 eff_conjunction : '(' KEY_AND effect-list ')' {$$ = new general_formula(); $$->type=AND; $$->subformulae = *($3);}
-eff_universal : '(' KEY_FORALL '(' typed_or_untyped_var_list  ')' effect ')'{$$ = new general_formula(); $$->type = FORALL; $$->subformulae.push_back($6); $$->qvariables = *($4);}
+eff_universal : '(' KEY_FORALL '(' typed_or_untyped_var_list  ')' effect ')'{$$ = new general_formula(); $$->type = FORALL; $$->subformulae.push_back($6); $$->mutable_qvariables() = *($4);}
 eff_conditional : '(' KEY_WHEN gd effect ')' {$$ = new general_formula(); $$->type=WHEN; $$->subformulae.push_back($3); $$->subformulae.push_back($4);}
 
 
@@ -524,22 +551,22 @@ neg_atomic_formula : '(' KEY_NOT atomic_formula ')' {$$ = $3; $$->negate();}
 p_effect : '(' assign_op f_head f_exp ')' {$$ = new general_formula(); $$->type=COST_CHANGE; $$->subformulae.push_back($3); $$->subformulae.push_back($4); }
 assign_op : KEY_INCREASE
 f_head : NAME { $$ = new general_formula(); $$->type = COST; $$->predicate = $1; }
-f_head : '(' NAME var_or_const-list ')' { $$ = new general_formula(); $$->type = COST; $$->predicate = $2; $$->arguments = *($3); }
+f_head : '(' NAME var_or_const-list ')' { $$ = new general_formula(); $$->type = COST; $$->predicate = $2; $$->mutable_arguments() = *($3); }
 f_exp : INT { $$ = new general_formula(); $$->type = VALUE; $$->value = $1; }
 f_exp : f_head { $$ = $1; }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // elementary list of names
-NAME-list-non-empty: NAME NAME-list {string s($1); free($1); $$ = $2; $$->push_back(s);}
+NAME-list-non-empty: NAME NAME-list {string s($1); $$ = $2; $$->push_back(s);}
 
-NAME-list: NAME-list NAME {string s($2); free($2); $$->push_back(s);}
+NAME-list: NAME-list NAME {string s($2); $$->push_back(s);}
 			|  {$$ = new vector<string>();} 
 
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 // elementary list of variable names
-VAR_NAME-list-non-empty: VAR_NAME-list VAR_NAME {string s($2); free($2); $$->push_back(s);}
-VAR_NAME-list: VAR_NAME-list VAR_NAME {string s($2); free($2); $$->push_back(s);}
+VAR_NAME-list-non-empty: VAR_NAME-list VAR_NAME {string s($2); $$->push_back(s);}
+VAR_NAME-list: VAR_NAME-list VAR_NAME {string s($2); $$->push_back(s);}
 			|  {$$ = new vector<string>();} 
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -554,7 +581,7 @@ typed_var : VAR_NAME '-' NAME { $$ = new var_declaration; string v($1); string t
 
 typed_or_untyped_var_list :  {$$ = new var_declaration;} 
 						| VAR_NAME-list-non-empty {
-							sortObjectNeeded = true;
+							ctx->sort_object_needed = true;
 		   					$$ = new var_declaration;
 							for (unsigned int i = 0; i < $1->size(); i++)
 								$$->vars.push_back(make_pair((*($1))[i],"object"));
@@ -577,12 +604,137 @@ typed_var_list : typed_var_list typed_vars {
 
 
 %%
-void run_parser_on_file(FILE* f, char* filename){
-	current_parser_file_name = filename;
-	yyin = f;
-	yyparse();
+const size_t SYMBOL_BLOCK_SIZE = 1 << 16;
+
+const char* symbol_table::intern(const char* s, size_t len){
+	auto it = symbols.find(string_view(s,len));
+	if (it != symbols.end()) return it->second;
+
+	// copy the name into the current block, or start a new one if it is full
+	if (len + 1 > block_free){
+		size_t size = max(SYMBOL_BLOCK_SIZE, len + 1);
+		blocks.push_back(new char[size]);
+		block_pos = blocks.back();
+		block_free = size;
+	}
+	char* copy = block_pos;
+	memcpy(copy, s, len);
+	copy[len] = 0;
+	block_pos += len + 1;
+	block_free -= len + 1;
+
+	symbols[string_view(copy,len)] = copy;
+	return copy;
+}
 
+symbol_table::~symbol_table(){
+	for (char* block : blocks) delete[] block;
+}
 
+// flex scans a buffer in place if it ends in two NUL bytes. We memory-map the input file if the zero-filled tail of its last page has room for them and read it into memory otherwise (and on Windows, which has no mmap).
+struct input_buffer{
+	char* data = NULL;
+	size_t size = 0;
+	bool mapped = false;
+};
+
+bool load_input(FILE* f, input_buffer & buf){
+	struct stat st;
+	if (fstat(fileno(f), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+	size_t file_size = st.st_size;
+	buf.size = file_size + 2;
+
+#ifndef _WIN32
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	if (file_size % page_size != 0 && page_size - file_size % page_size >= 2){
+		// private mapping, as flex temporarily writes into the buffer
+		void* m = mmap(NULL, buf.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f), 0);
+		if (m != MAP_FAILED){
+			buf.data = (char*) m;
+			buf.mapped = true;
+			return true;
+		}
+	}
+#endif
+
+	buf.data = new char[buf.size];
+	size_t read = 0;
+	while (read < file_size){
+		size_t r = fread(buf.data + read, 1, file_size - read, f);
+		if (r == 0) break;
+		read += r;
+	}
+	buf.data[read] = buf.data[read + 1] = 0;
+	buf.size = read + 2;
+	return true;
+}
+
+void release_input(input_buffer & buf){
+	if (buf.mapped){
+#ifndef _WIN32
+		munmap(buf.data, buf.size);
+#endif
+	} else delete[] buf.data;
+}
+
+void parse_file(FILE* f, const char* filename, parse_context & ctx){
+	ctx.file_name = filename;
+	yyscan_t scanner;
+	yylex_init_extra(&ctx, &scanner);
+
+	input_buffer input;
+	bool buffered = detect_compression(f) == COMPRESSION_NONE && load_input(f, input);
+	if (buffered && stream_init_sections && find_init_section(input.data, input.size - 2, input.mapped, ctx.streamed_init)){
+		// flex reads the file without the :init section, s.t. it never has to be held in memory
+		release_input(input);
+		buffered = false;
+		rewind(f);
+		ctx.streamed_init.file_name = filename;
+		ctx.input = new decompressing_reader(f, filename);
+		ctx.input->skip(ctx.streamed_init.begin, ctx.streamed_init.end);
+		yyset_in(f, scanner);
+	} else if (buffered) {
+		// the large sections of problems are parsed in parallel before and then skipped by flex
+		parse_problem_sections(input.data, input.size - 2, ctx);
+		yy_scan_buffer(input.data, input.size, scanner);
+	} else {
+		// compressed files, pipes, and other non-regular files are streamed
+		ctx.input = new decompressing_reader(f, filename);
+		yyset_in(f, scanner);
+	}
+
+	yyparse(scanner, &ctx);
+	yylex_destroy(scanner);
+	if (buffered) release_input(input);
+	delete ctx.input;
+	ctx.input = NULL;
+}
+
+bool stream_init_sections = false;
+init_section streamed_init;
+
+// the object sort has to be declared, if any of the parsed files used it
+bool sortObjectNeeded = false;
+
+void merge_parse_context(parse_context & ctx){
+	if (ctx.has_typeof_predicate) has_typeof_predicate = true;
+	sort_definitions.insert(sort_definitions.end(), ctx.sort_definitions.begin(), ctx.sort_definitions.end());
+	predicate_definitions.insert(predicate_definitions.end(), ctx.predicate_definitions.begin(), ctx.predicate_definitions.end());
+	parsed_primitive.insert(parsed_primitive.end(), ctx.parsed_primitive.begin(), ctx.parsed_primitive.end());
+	parsed_abstract.insert(parsed_abstract.end(), ctx.parsed_abstract.begin(), ctx.parsed_abstract.end());
+	for (auto & [at, ms] : ctx.parsed_methods)
+		parsed_methods[at].insert(parsed_methods[at].end(), ms.begin(), ms.end());
+	parsed_functions.insert(parsed_functions.end(), ctx.parsed_functions.begin(), ctx.parsed_functions.end());
+	if (ctx.metric_target != dummy_function_type) metric_target = ctx.metric_target;
+	for (auto & [s, elems] : ctx.sorts) sorts[s].insert(elems.begin(), elems.end());
+
+	init.append(ctx.init);
+	init_functions.insert(init_functions.end(), ctx.init_functions.begin(), ctx.init_functions.end());
+	if (ctx.goal_formula) goal_formula = ctx.goal_formula;
+	if (ctx.streamed_init.file_name.size()) streamed_init = ctx.streamed_init;
+
+
+	if (ctx.sort_object_needed) sortObjectNeeded = true;
 	if (sortObjectNeeded){
 		sort_definition s;
 		s.has_parent_sort = false;
@@ -591,8 +743,39 @@ void run_parser_on_file(FILE* f, char* filename){
 	}
 }
 
-void yyerror(const char *s) {
-  cout << "\x1b[31mParse error\x1b[0m in file " << current_parser_file_name << " in line \x1b[1m" << yylloc.first_line << "\x1b[0m" << endl;
+void run_parser_on_file(FILE* f, char* filename){
+	parse_context ctx;
+	parse_file(f, filename, ctx);
+	merge_parse_context(ctx);
+}
+
+void parse_domain_file(FILE* f, const char* filename, parse_context & ctx, const char* cache_dir){
+	string key;
+	if (cache_dir && domain_cache_key(f, key)){
+		if (load_domain_cache(cache_dir, key, ctx)){
+			ctx.file_name = filename;
+			return;
+		}
+		parse_file(f, filename, ctx);
+		store_domain_cache(cache_dir, key, ctx);
+	} else
+		parse_file(f, filename, ctx);
+}
+
+void run_parser_on_files(FILE* domain, char* domain_name, FILE* problem, char* problem_name, const char* domain_cache,
+		const function<void(parse_context &)> & domain_parsed){
+	parse_context domain_ctx, problem_ctx;
+	thread problem_thread(parse_file, problem, problem_name, ref(problem_ctx));
+	parse_domain_file(domain, domain_name, domain_ctx, domain_cache);
+	if (domain_parsed) domain_parsed(domain_ctx);
+	problem_thread.join();
+
+	merge_parse_context(domain_ctx);
+	merge_parse_context(problem_ctx);
+}
+
+void yyerror(YYLTYPE* loc, yyscan_t scanner, parse_context* ctx, const char *s) {
+  cout << "\x1b[31mParse error\x1b[0m in file " << ctx->file_name << " in line \x1b[1m" << loc->first_line << "\x1b[0m" << endl;
   if (strlen(s) >= 14 && (strncmp("syntax error, ",s,14) == 0)){
     s += 14;
   }
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <unordered_set>
 #include "hddlWriter.hpp"
+#include "chunkparser.hpp"
 #include "parsetree.hpp"
 #include "hddl.hpp"
 #include "domain.hpp"
@@ -62,40 +63,31 @@ tuple<vector<string>,
 	vector<string> sortsInOrder;
 	for(auto & [s,_] : sorts) sortsInOrder.push_back(s);
 
-	vector<vector<bool>> subset (sortsInOrder.size());
+	sort_lattice lattice;
+	vector<int> elements;
+	for (const string & s : sortsInOrder) elements.push_back(lattice.sort_set(s));
+
+	vector<id_bitset> subset (sortsInOrder.size());
 	
 	for (size_t s1I = 0; s1I < sortsInOrder.size(); s1I++){
-		string s1 = sortsInOrder[s1I];
-
-		if (!sorts[s1].size()) {
-			for (size_t s2 = 0; s2 < sortsInOrder.size(); s2++) subset[s1I].push_back(false);
-			continue;
-		}
+		if (!lattice.size(elements[s1I])) continue;
 
-		for (size_t s2I = 0; s2I < sortsInOrder.size(); s2I++){
-			string s2 = sortsInOrder[s2I];
-			if (s1I != s2I && sorts[s2].size()){
-				if (includes(sorts[s1].begin(), sorts[s1].end(),
-							sorts[s2].begin(), sorts[s2].end())){
-					// here we know that s2 is a subset of s1
-					subset[s1I].push_back(true);
-				} else
-					subset[s1I].push_back(false);
-			} else subset[s1I].push_back(false);
-		}
+		for (size_t s2I = 0; s2I < sortsInOrder.size(); s2I++)
+			if (s1I != s2I && lattice.size(elements[s2I]) && lattice.is_subset(elements[s2I], elements[s1I]))
+				// here we know that s2 is a subset of s1
+				bitset_insert(subset[s1I], s2I);
 	}
 
 	// transitive reduction
 	for (size_t s1 = 0; s1 < sortsInOrder.size(); s1++)
 		for (size_t s2 = 0; s2 < sortsInOrder.size(); s2++)
-			for (size_t s3 = 0; s3 < sortsInOrder.size(); s3++)
-				if (subset[s2][s1] && subset[s1][s3])
-					subset[s2][s3] = false;
+			if (bitset_contains(subset[s2], s1))
+				bitset_subtract(subset[s2], subset[s1]);
 	
 	
 	/*for (size_t s1 = 0; s1 < sortsInOrder.size(); s1++){
 		for (size_t s2 = 0; s2 < sortsInOrder.size(); s2++){
-			if (subset[s1][s2]){
+			if (bitset_contains(subset[s1], s2)){
 				cout << sortsInOrder[s2];
 				cout << " is a subset of ";
 				cout << sortsInOrder[s1];
@@ -113,7 +105,7 @@ tuple<vector<string>,
 	
 	for (size_t s1 = 0; s1 < sortsInOrder.size(); s1++)
 		for (size_t s2 = 0; s2 < sortsInOrder.size(); s2++)
-			if (subset[s1][s2]){
+			if (bitset_contains(subset[s1], s2)){
 				parents[s2].insert(s1);
 				if (parent[s2] != -1){
 					if (parent[s2] >= 0) {
@@ -170,7 +162,7 @@ tuple<vector<string>,
 	vector<unordered_set<int>> directsubset (sortsInOrder.size());
 	for (size_t s1 = 0; s1 < sortsInOrder.size(); s1++)
 		for (size_t s2 = 0; s2 < sortsInOrder.size(); s2++) if (parent[s2] >= 0)
-			if (subset[s1][s2]){
+			if (bitset_contains(subset[s1], s2)){
 				if (replacedSorts.count(s1))
 					directsubset[replacedSorts[s1]].insert(s2);
 				else
@@ -227,7 +219,7 @@ void print_indent(ostream & out, int indent, bool end){
 		out << "  ";
 }
 
-void print_var_and_const(ostream & out, var_and_const & vars){
+void print_var_and_const(ostream & out, const var_and_const & vars){
 	map<string,string> constants;
 	for (auto [v,s] : vars.newVar)
 		constants[v] = *sorts[s].begin();
@@ -258,7 +250,7 @@ void print_formula(ostream & out, general_formula * f, int indent){
 		if (f->type == FORALL) out << "forall"; else out << "exists";
 		out << " (";
 		bool first = true;
-		for (auto [v,s] : f->qvariables.vars){
+		for (auto [v,s] : f->qvariables().vars){
 			if (!first) out << " ";
 			out << v << " - " << s;
 			first = false;
@@ -275,7 +267,7 @@ void print_formula(ostream & out, general_formula * f, int indent){
 		print_indent(out,indent);
 		if (f->type == NOTATOM) out << "(not ";
 		out << "(" << f->predicate;
-		print_var_and_const(out,f->arguments);
+		print_var_and_const(out,f->arguments());
 		if (f->type == NOTATOM) out << ")";
 		out << ")" << endl;
 	}
@@ -292,7 +284,7 @@ void print_formula(ostream & out, general_formula * f, int indent){
 	if (f->type == EQUAL || f->type == NOTEQUAL){
 		print_indent(out,indent);
 		if (f->type == NOTEQUAL) out << "(not ";
-		out << "(= " << f->arg1 << " " << f->arg2;
+		out << "(= " << f->arg1() << " " << f->arg2();
 		if (f->type == NOTEQUAL) out << ")";
 		out << ")" << endl;
 	}
@@ -832,7 +824,27 @@ void hddl_output(ostream & dout, ostream & pout, bool internalHDDLOutput, bool u
 	
 
 	pout << "  (:init" << endl;
-	for (auto gl : init){
+	if (streamed_init.file_name.size()){
+		// the facts go straight from the problem file to the output. Function values are collected, as they are written last
+		bool ok = read_init_section(streamed_init,
+			[&](string_view predicate, const vector<string_view> & args){
+				pout << "    (" << sanitise(string(predicate));
+				for (string_view c : args) pout << " " << sanitise(string(c));
+				pout << ")\n";
+			},
+			[&](string_view function, const vector<string_view> & args, int value){
+				ground_literal l;
+				l.positive = true;
+				l.predicate = function;
+				for (string_view c : args) l.args.push_back(string(c));
+				init_functions.push_back(make_pair(l, value));
+			});
+		if (!ok){
+			cout << "\x1b[31mError\x1b[0m: could not read the initial state from " << streamed_init.file_name << " again" << endl;
+			exit(1);
+		}
+	}
+	for (auto gl : init.literals()){
 		if (!gl.positive && !internalHDDLOutput) continue; // don't output negatives in normal mode
 		pout << "    (";
 	   	if (!gl.positive){
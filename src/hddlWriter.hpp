@@ -12,7 +12,7 @@ tuple<vector<string>,
 	  map<int,int> > compute_local_type_hierarchy();
 
 void print_indent(ostream & out, int indent, bool end = false);
-void print_var_and_const(ostream & out, var_and_const & vars);
+void print_var_and_const(ostream & out, const var_and_const & vars);
 void print_formula(ostream & out, general_formula * f, int indent);
 void print_formula_for(ostream & out, general_formula * f, string topic);
 
@@ -103,7 +103,7 @@ void write_HPDL_general_formula(ostream & out, general_formula * f, function<str
 	if (f->type == ATOM || f->type == NOTATOM){
 		if (f->type == NOTATOM) out << "(not ";
 		out << "(" << f->predicate;
-		for (string & v : f->arguments.vars) out << " " << var(v);
+		for (const string & v : f->arguments().vars) out << " " << var(v);
 		if (f->type == NOTATOM) out << ")";
 		out << ")" << endl;
 		return;
@@ -121,7 +121,7 @@ void write_HPDL_general_formula(ostream & out, general_formula * f, function<str
 		if (f->type == FORALL || f->type == EXISTS){
 			out << " (";
 			int first = 0;
-			for(pair<string,string> varDecl : f->qvariables.vars){
+			for(pair<string,string> varDecl : f->qvariables().vars){
 				if (first++) out << " ";
 				out << varDecl.first << " - " << get_hpdl_sort_name(varDecl.second);
 			}
@@ -139,7 +139,7 @@ void write_HPDL_general_formula(ostream & out, general_formula * f, function<str
 
 	if (f->type == EQUAL || f->type == NOTEQUAL){
 		if (f->type == NOTEQUAL) out << "(not ";
-		out << "(= " << var(f->arg1) << " " << var(f->arg2) << ")";
+		out << "(= " << var(f->arg1()) << " " << var(f->arg2()) << ")";
 		if (f->type == NOTEQUAL) out << ")";
 		out << endl;
 		return;
@@ -147,7 +147,7 @@ void write_HPDL_general_formula(ostream & out, general_formula * f, function<str
 
 	if (f->type == OFSORT || f->type == NOTOFSORT){
 		if (f->type == NOTOFSORT) out << "(not ";
-		out << "(type_member_" << get_hpdl_sort_name(f->arg2) << " " << var(f->arg1) << ")";
+		out << "(type_member_" << get_hpdl_sort_name(f->arg2()) << " " << var(f->arg1()) << ")";
 		if (f->type == NOTOFSORT) out << ")";
 		out << endl;
 		return;
@@ -336,7 +336,7 @@ void write_instance_as_HPDL(ostream & dout, ostream & pout){
 
 	// write the rest of the problem s.t. we can insert the content of the top method at the correct position
 	pout << "  (:init" << endl;
-	for (ground_literal & lit : init){
+	for (ground_literal & lit : init.literals()){
 		if (!lit.positive) continue;
 		pout << "    (" << lit.predicate;
 		for (string & arg : lit.args)
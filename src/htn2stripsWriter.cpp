@@ -303,7 +303,7 @@ void htn2strips_output(ostream & dout, ostream & pout){
 	*/
 
 	pout << "  (:init" << endl;
-	for (auto gl : init){
+	for (auto gl : init.literals()){
 		if (!gl.positive) continue; // don't output negatives in normal mode
 		pout << "    (";
 	   	if (!gl.positive){
@@ -4,6 +4,7 @@
 #include "util.hpp"
 #include <iostream>
 #include <algorithm>
+#include <array>
 
 using namespace std;
 
@@ -378,9 +379,9 @@ void add_prec(method & m, inf_t & inf, string & predicate, bool positive) {
         // Check if literals is already contained in all the preceding tasks (this helps against trivial inference)
         bool redundant = true;
         for (auto task : preceding_tasks[m.name]) {
-            auto t = task_name_map[task];
+            const auto & t = task_name_map[task];
             bool contained = false;
-            for (auto prec : t.prec) {
+            for (const auto & prec : t.prec) {
                 if (prec.positive == positive && prec.predicate == predicate && prec.arguments == sig) {
                     contained = true;
                     break;
@@ -1,13 +1,21 @@
 #include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <getopt.h>
 #include <iostream>
 #include <map>
+#include <sstream>
+#include <thread>
 #include <vector>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
+#include "compression.hpp"
 #include "cwa.hpp"
 #include "domain.hpp"
 #include "hddl.hpp"
@@ -17,6 +25,8 @@
 #include "output.hpp"
 #include "inference.hpp"
 #include "parametersplitting.hpp"
+#include "parser.hpp"
+#include "passmanager.hpp"
 #include "tworegularize.hpp"
 #include "parsetree.hpp"
 #include "plan.hpp"
@@ -31,9 +41,6 @@
 
 using namespace std;
 
-// declare parser function manually
-void run_parser_on_file(FILE* f, char* filename);
-
 // parsed domain data structures
 bool has_typeof_predicate = false;
 vector<sort_definition> sort_definitions;
@@ -81,6 +88,11 @@ int main(int argc, char** argv) {
 	bool convertPlan = false;
 	bool showProperties = false;
 	bool removeMethodPreconditions = false;
+	const char* domainCache = NULL;
+	const char* batchManifest = NULL;
+	const char* passList = NULL;
+	bool passStats = false;
+	unsigned int numberOfJobs = max(1u, thread::hardware_concurrency());
 	int verbosity = 0;
 	
 	gengetopt_args_info args_info;
@@ -100,6 +112,10 @@ int main(int argc, char** argv) {
 		compileConditionalEffects = false; linearConditionalEffectExpansion = true;
 	}
 	if (args_info.encode_disjunctive_preconditions_in_htn_given) encodeDisjunctivePreconditionsInMethods = true;
+	if (args_info.auxiliary_disjunctions_given && !encodeDisjunctivePreconditionsInMethods) auxiliary_disjunctions = true;
+	if (args_info.max_dnf_branches_given) max_expansion_branches = max(0, args_info.max_dnf_branches_arg);
+	if (args_info.lifted_forall_given) keep_forall_lifted = true;
+	if (args_info.implicit_cwa_given) implicit_cwa = true;
 	if (args_info.goal_action_given) compileGoalIntoAction = true;
 	if (args_info.remove_method_preconditions_given) removeMethodPreconditions = true;
 
@@ -110,6 +126,10 @@ int main(int argc, char** argv) {
 	if (args_info.hddl_given) pureHddlOutput = true;
 	if (args_info.processed_hddl_given) hddlOutput = true;
 	if (args_info.internal_hddl_given) hddlOutput = internalHDDLOutput = true;
+	// the other output formats need the quantifiers expanded and the negative facts in the initial state. So do the encodings that split actions for the quantifiers
+	bool otherOutput = shopOutput || hpdlOutput || htn2stripsOutput || hddlOutput;
+	if (otherOutput || linearConditionalEffectExpansion || encodeDisjunctivePreconditionsInMethods || auxiliary_disjunctions) keep_forall_lifted = false;
+	if (otherOutput) implicit_cwa = false;
 
 	if (args_info.verify_given){
 		verifyPlan = true;
@@ -128,9 +148,32 @@ int main(int argc, char** argv) {
 		verifyPlan = true;
 		useOrderInPlanVerification = false;
 	}
+	// typeOf is compiled into sort constraints during the lowering. The other formats and the verifier use the facts
+	if (!otherOutput && !verifyPlan) implicit_typeof = true;
 
 	if (args_info.panda_converter_given) convertPlan = true;
 	if (args_info.properties_given) showProperties = true;
+	if (args_info.domain_cache_given) domainCache = args_info.domain_cache_arg;
+	if (args_info.batch_given) batchManifest = args_info.batch_arg;
+	if (args_info.jobs_given) numberOfJobs = max(1, args_info.jobs_arg);
+	if (args_info.passes_given) passList = args_info.passes_arg;
+	if (args_info.pass_stats_given) passStats = true;
+	if (args_info.list_passes_given){
+		list_passes(cout);
+		return 0;
+	}
+
+	vector<const transformation_pass*> pipeline;
+	if (passList){
+		if (!parse_pipeline(passList, pipeline)) return 1;
+	} else for (const transformation_pass & p : registered_passes()){
+		if (p.name == "split-parameters" && !splitParameters) continue;
+		if (p.name == "two-regularization" && !tworegularizeMethods) continue;
+		if (p.name == "infer-preconditions" && !inferPreconditions) continue;
+		pipeline.push_back(&p);
+	}
+	// the untransformed output does not need the initial state in memory
+	if (pureHddlOutput) stream_init_sections = true;
 
 	
 	cout << "pandaPIparser is configured as follows" << endl;
@@ -146,9 +189,9 @@ int main(int argc, char** argv) {
 		cout << "  Ignore given order: " << !useOrderInPlanVerification << endl;
 	} else {
 		cout << "  Mode: parsing mode" << endl;
-		cout << "  Parameter splitting: " << boolalpha << splitParameters << endl;
-		cout << "  Two-regularization: " << boolalpha << tworegularizeMethods << endl;
-		cout << "  Precondition inference: " << boolalpha << inferPreconditions << endl;
+		cout << "  Transformation passes:";
+		for (const transformation_pass * p : pipeline) cout << " " << p->name;
+		cout << endl;
 		cout << "  Conditional effects: ";
 		if (compileConditionalEffects){
 			if (linearConditionalEffectExpansion) cout << "linear encoding";
@@ -156,7 +199,13 @@ int main(int argc, char** argv) {
 		} else cout << "keep";
 		cout << endl;	
 		cout << "  Disjunctive preconditions as HTN: " << boolalpha << encodeDisjunctivePreconditionsInMethods << endl;
+		if (auxiliary_disjunctions) cout << "  Disjunctive preconditions: auxiliary predicates" << endl;
+		if (max_expansion_branches) cout << "  Maximum instances per action: " << max_expansion_branches << endl;
+		if (keep_forall_lifted) cout << "  Universal quantifiers: lifted" << endl;
+		if (implicit_cwa) cout << "  Closed world assumption: implicit" << endl;
 		cout << "  Replace goal with action: " << boolalpha << compileGoalIntoAction << endl;
+		if (domainCache) cout << "  Domain cache: " << domainCache << endl;
+		if (batchManifest) cout << "  Batch: " << batchManifest << " with " << numberOfJobs << " jobs" << endl;
 	
 		cout << "  Output: ";
 		if (shopOutput) cout << "SHOP2";
@@ -193,8 +242,8 @@ int main(int argc, char** argv) {
 		ifstream * plan   = new ifstream(inputFiles[dfile]);
 		ostream * outplan = &cout;
 		if (pfile != -1){
-			ofstream * of  = new ofstream(inputFiles[pfile]);
-			if (!of->is_open()){
+			ostream * of = open_output_file(inputFiles[pfile]);
+			if (!of){
 				cout << "I can't open " << inputFiles[pfile] << "!" << endl;
 				return 2;
 			}
@@ -206,6 +255,110 @@ int main(int argc, char** argv) {
 		return 0;
 	}
 
+	// the parts of the lowering that only depend on the domain are done as soon as the domain is parsed, i.e. while the problem is still being parsed
+	bool lowering = !showProperties && !pureHddlOutput && !htn2stripsOutput && !hpdlOutput && !verifyPlan;
+	auto lower_domain = [&](parse_context & domain_ctx){
+		if (!lowering) return;
+		simplify_domain_formulae(domain_ctx.parsed_primitive, domain_ctx.parsed_methods);
+		precompute_domain_lowering(domain_ctx.parsed_primitive, domain_ctx.parsed_methods,
+				compileConditionalEffects, encodeDisjunctivePreconditionsInMethods, !removeMethodPreconditions);
+	};
+
+	// batch mode: the domain is parsed once, then every problem of the manifest is processed by its own worker process, which starts with a copy of the parsed domain
+	if (batchManifest){
+#ifdef _WIN32
+		// the workers are forked from the process that has parsed the domain
+		cout << "Batch mode needs fork and is not available on Windows. Process the problems one by one instead." << endl;
+		return 1;
+#else
+		ifstream manifest(batchManifest);
+		if (!manifest.is_open()){
+			cout << "I can't open " << batchManifest << "!" << endl;
+			return 2;
+		}
+		vector<vector<string>> jobs;
+		string line;
+		while (getline(manifest, line)){
+			istringstream ls(line);
+			vector<string> files;
+			string file;
+			while (ls >> file) files.push_back(file);
+			if (files.size() == 0 || files[0][0] == '#') continue;
+			jobs.push_back(files);
+		}
+
+		FILE *domain_file = fopen(inputFiles[dfile].c_str(), "r");
+		if (!domain_file) {
+			cout << "I can't open " << inputFiles[dfile] << "!" << endl;
+			return 2;
+		}
+		parse_context domain_ctx;
+		parse_domain_file(domain_file, inputFiles[dfile].c_str(), domain_ctx, domainCache);
+		lower_domain(domain_ctx);
+		merge_parse_context(domain_ctx);
+		fclose(domain_file);
+
+		// anything still buffered would otherwise be written by every worker
+		cout.flush();
+		map<pid_t,size_t> running;
+		size_t next = 0;
+		int failed = 0;
+		bool isWorker = false;
+		while (next < jobs.size() || running.size()){
+			if (next < jobs.size() && running.size() < numberOfJobs){
+				pid_t pid = fork();
+				if (pid == 0) {
+					isWorker = true;
+					break;
+				}
+				if (pid == -1){
+					cout << "Could not start worker for " << jobs[next][0] << endl;
+					failed++;
+				} else
+					running[pid] = next;
+				next++;
+				continue;
+			}
+
+			int status;
+			pid_t pid = wait(&status);
+			if (pid == -1){
+				if (errno == EINTR) continue;
+				// the remaining workers cannot be waited for, so neither they nor the jobs not yet started count as processed
+				cout << "Could not wait for the workers: " << strerror(errno) << endl;
+				for (auto & [_, job] : running){
+					cout << color(COLOR_RED, "Failed") << " to process " << jobs[job][0] << endl;
+					failed++;
+				}
+				for (; next < jobs.size(); next++){
+					cout << color(COLOR_RED, "Failed") << " to process " << jobs[next][0] << endl;
+					failed++;
+				}
+				break;
+			}
+			size_t job = running[pid];
+			running.erase(pid);
+			if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+				cout << color(COLOR_RED, "Failed") << " to process " << jobs[job][0] << endl;
+				failed++;
+			}
+		}
+
+		if (!isWorker){
+			cout << "Batch: processed " << jobs.size() - failed << " of " << jobs.size() << " problems successfully" << endl;
+			return failed ? 1 : 0;
+		}
+
+		// the worker continues as if it had been called with the domain and the arguments of its line in the manifest
+		string domain = inputFiles[dfile];
+		inputFiles = jobs[next];
+		inputFiles.insert(inputFiles.begin(), domain);
+		pfile = 1;
+		doutfile = inputFiles.size() > 2 ? 2 : -1;
+		poutfile = inputFiles.size() > 3 ? 3 : -1;
+#endif
+	}
+
 	if (pfile == -1 && !convertPlan){
 		cout << "You need to provide a domain and problem file as input." << endl;
 		return 1;
@@ -230,9 +383,9 @@ int main(int argc, char** argv) {
 	// parsing of command line arguments has been completed	
 		
 		
-	// parse the domain file
-	run_parser_on_file(domain_file, (char*) inputFiles[dfile].c_str());
-	run_parser_on_file(problem_file, (char*) inputFiles[pfile].c_str());
+	// parse the domain and problem file (concurrently). In batch mode, the domain has already been parsed before the worker was started
+	if (batchManifest) run_parser_on_file(problem_file, (char*) inputFiles[pfile].c_str());
+	else run_parser_on_files(domain_file, (char*) inputFiles[dfile].c_str(), problem_file, (char*) inputFiles[pfile].c_str(), domainCache, lower_domain);
 
 	if (showProperties){
 		printProperties();
@@ -244,16 +397,16 @@ int main(int argc, char** argv) {
 		ostream * dout = &cout;
 		ostream * pout = &cout;
 		if (doutfile != -1){
-			ofstream * df  = new ofstream(inputFiles[doutfile]);
-			if (!df->is_open()){
+			ostream * df = open_output_file(inputFiles[doutfile]);
+			if (!df){
 				cout << "I can't open " << inputFiles[doutfile] << "!" << endl;
 				return 2;
 			}
 			dout = df;
 		}
 		if (poutfile != -1){
-			ofstream * pf  = new ofstream(inputFiles[poutfile]);
-			if (!pf->is_open()){
+			ostream * pf = open_output_file(inputFiles[poutfile]);
+			if (!pf){
 				cout << "I can't open " << inputFiles[poutfile] << "!" << endl;
 				return 2;
 			}
@@ -293,6 +446,8 @@ int main(int argc, char** argv) {
 		flatten_goal();
 		// create appropriate methods and expand method preconditions
 		parsed_method_to_data_structures(compileConditionalEffects, linearConditionalEffectExpansion, encodeDisjunctivePreconditionsInMethods);
+		// typeOf preconditions become sort constraints
+		if (has_typeof_predicate && implicit_typeof) compile_typeof();
 	}
 
 	if (shopOutput || hpdlOutput){
@@ -300,16 +455,16 @@ int main(int argc, char** argv) {
 		ostream * dout = &cout;
 		ostream * pout = &cout;
 		if (doutfile != -1){
-			ofstream * df  = new ofstream(inputFiles[doutfile]);
-			if (!df->is_open()){
+			ostream * df = open_output_file(inputFiles[doutfile]);
+			if (!df){
 				cout << "I can't open " << inputFiles[doutfile] << "!" << endl;
 				return 2;
 			}
 			dout = df;
 		}
 		if (poutfile != -1){
-			ofstream * pf  = new ofstream(inputFiles[poutfile]);
-			if (!pf->is_open()){
+			ostream * pf = open_output_file(inputFiles[poutfile]);
+			if (!pf){
 				cout << "I can't open " << inputFiles[poutfile] << "!" << endl;
 				return 2;
 			}
@@ -320,18 +475,11 @@ int main(int argc, char** argv) {
 		return 0;
 	}
 
-	// split methods with independent parameters to reduce size of grounding
-	if (splitParameters) split_independent_parameters();
-    // two regularize totally ordered methods.
-    if (tworegularizeMethods) two_regularize_methods();
-    // infer preconditions for tasks for faster progression search.
-    if (inferPreconditions) infer_preconditions();
-	// cwa, but only if we actually want to compile negative preconditions
-	if (!hpdlOutput || internalHDDLOutput) compute_cwa();
-	// simplify constraints as far as possible
-	reduce_constraints();
-	clean_up_sorts();
-	remove_unnecessary_predicates();
+	// pandaPI's own output is generated from the lowered model only, we don't need the parse tree any more
+	if (!hddlOutput) release_parse_tree();
+
+	// transform the lowered model, by default: parameter splitting, two-regularization, precondition inference, cwa, and simplification of constraints and sorts
+	run_pipeline(pipeline, passStats);
 
 	// write to output
 	if (verboseOutput) verbose_output(verbosity);
@@ -340,16 +488,16 @@ int main(int argc, char** argv) {
 		ostream * dout = &cout;
 		ostream * pout = &cout;
 		if (doutfile != -1){
-			ofstream * df  = new ofstream(inputFiles[doutfile]);
-			if (!df->is_open()){
+			ostream * df = open_output_file(inputFiles[doutfile]);
+			if (!df){
 				cout << "I can't open " << inputFiles[doutfile] << "!" << endl;
 				return 2;
 			}
 			dout = df;
 		}
 		if (poutfile != -1){
-			ofstream * pf  = new ofstream(inputFiles[poutfile]);
-			if (!pf->is_open()){
+			ostream * pf = open_output_file(inputFiles[poutfile]);
+			if (!pf){
 				cout << "I can't open " << inputFiles[poutfile] << "!" << endl;
 				return 2;
 			}
@@ -359,8 +507,8 @@ int main(int argc, char** argv) {
 	} else {
 		ostream * dout = &cout;
 		if (doutfile != -1){
-			ofstream * df  = new ofstream(inputFiles[doutfile]);
-			if (!df->is_open()){
+			ostream * df = open_output_file(inputFiles[doutfile]);
+			if (!df){
 				cout << "I can't open " << inputFiles[doutfile] << "!" << endl;
 				return 2;
 			}
@@ -3,6 +3,7 @@
 #include <vector>
 #include <map>
 #include <cassert>
+#include <algorithm>
 #include "output.hpp"
 #include "parsetree.hpp"
 #include "hddl.hpp"
@@ -92,7 +93,7 @@ void verbose_output(int verbosity){
 	}
 
 	cout << "Initial state: " << init.size() << endl;
-	if (verbosity > 0) for(ground_literal l : init){
+	if (verbosity > 0) for(ground_literal l : init.literals()){
 		cout << "\t" << (l.positive?"+":"-")<< color(COLOR_BLUE,l.predicate);
 		for(string c : l.args) cout << " " << c;
 		cout << endl;
@@ -106,51 +107,22 @@ void verbose_output(int verbosity){
 	}
 }
 
-void simple_hddl_output(ostream & dout){
-	// prep indices
-	map<string,int> constants;
-	vector<string> constants_out;
-	for (auto x : sorts) for (string s : x.second) {
-		if (constants.count(s) == 0) constants[s] = constants.size(), constants_out.push_back(s);
-	}
-
-	map <string,int> sort_id;
-	vector<pair<string,set<string>>> sort_out;
-	for (auto x : sorts) if (!sort_id.count(x.first))
-		sort_id[x.first] = sort_id.size(), sort_out.push_back(x);
-
-	set<string> neg_pred;
-	for (task t : primitive_tasks) for (literal l : t.prec) if (!l.positive) neg_pred.insert(l.predicate);
-	for (task t : primitive_tasks) for (conditional_effect ceff : t.ceff) for (literal l : ceff.condition) if (!l.positive) neg_pred.insert(l.predicate);
-	for (auto l : goal) if (!l.positive) neg_pred.insert(l.predicate);
-
-	map<string,int> predicates;
-	vector<pair<string,predicate_definition>> predicate_out;
-	vector<pair<string,string>> mutexPredicates;
-	for (auto p : predicate_definitions){
-		predicates["+" + p.name] = predicates.size();
-		predicate_out.push_back(make_pair("+" + p.name, p));
-
-		if (neg_pred.count(p.name)){
-			predicates["-" + p.name] = predicates.size();
-			predicate_out.push_back(make_pair("-" + p.name, p));
-
-			// + and - predicates are known mutexes ...
-			mutexPredicates.push_back(make_pair("+" + p.name, "-" + p.name));
-		}
+// the id of a name in the output. Every name the lowered model refers to has to be declared
+int output_id(const map<string,int> & ids, const string & name){
+	auto it = ids.find(name);
+	if (it == ids.end()){
+		cerr << "\x1b[31mError\x1b[0m: " << name << " is used, but not declared in the model." << endl;
+		exit(1);
 	}
+	return it->second;
+}
 
-	map<string,int> function_declarations;
-	vector<predicate_definition> functions_out;
+void simple_hddl_output(ostream & dout){
 	for (auto p : parsed_functions){
 		if (p.second != numeric_funtion_type){
 			cerr << "the parser currently supports only numeric (type \"number\") functions." << endl;
 			exit(1);
 		}
-
-		if (p.first.name == metric_target) continue; // don't output the metric target, we don't need it
-		function_declarations[p.first.name] = function_declarations.size();
-		functions_out.push_back(p.first);
 	}
 
 	// determine whether the instance actually has action costs. If not, we insert in the output that every action has cost 1
@@ -158,7 +130,7 @@ void simple_hddl_output(ostream & dout){
 
 
 	bool instance_is_classical = true;
-	for (task t : abstract_tasks)
+	for (const task & t : abstract_tasks)
 		if (t.name == "__top") instance_is_classical = false;
 
 	// if we are in a classical domain remove everything HTNy
@@ -166,82 +138,153 @@ void simple_hddl_output(ostream & dout){
 		abstract_tasks.clear();
 		methods.clear();
 	}
-	
 
-	map<string,int> task_id;
-	vector<pair<task,bool>> task_out;
-	for (task t : primitive_tasks){
-		if (task_id.count(t.name) != 0){
-			cerr << "Duplicate primitive task " << t.name << endl;
+	// prep indices
+	map<string,int> constants;
+	vector<string> constants_out;
+	for (auto & [_, elems] : sorts) for (const string & c : elems)
+		if (!constants.count(c)){
+			int id = constants_out.size();
+			constants[c] = id;
+			constants_out.push_back(c);
 		}
-		assert(task_id.count(t.name) == 0);
-		task_id[t.name] = task_id.size();
-		task_out.push_back(make_pair(t,true));
+
+	map<string,int> sort_id;
+	for (auto & [s, _] : sorts){
+		int id = sort_id.size();
+		sort_id[s] = id;
+	}
+
+	// only predicates that occur negatively in a precondition or the goal get a "-" version
+	set<string> neg_pred;
+	auto negative_predicates = [&](const vector<literal> & ls){
+		for (const literal & l : ls) if (!l.positive) neg_pred.insert(l.predicate);
+	};
+	for (const task & t : primitive_tasks){
+		negative_predicates(t.prec);
+		for (const conditional_effect & ceff : t.ceff) negative_predicates(ceff.condition);
+		for (const quantified_literals & q : t.forall_prec) negative_predicates(q.literals);
+		for (const quantified_literals & q : t.forall_eff) negative_predicates(q.condition);
 	}
-	for (task t : abstract_tasks){
-		if (task_id.count(t.name) != 0){
-			cerr << "Duplicate abstract task " << t.name << endl;
+	for (const ground_literal & l : goal) if (!l.positive) neg_pred.insert(l.predicate);
+
+	// ids of the "+" and "-" version of every predicate in the output
+	map<string,int> predicates[2];
+	vector<pair<bool,const predicate_definition*>> predicate_out;
+	for (const predicate_definition & p : predicate_definitions){
+		predicates[true][p.name] = predicate_out.size();
+		predicate_out.push_back(make_pair(true, &p));
+		if (neg_pred.count(p.name)){
+			predicates[false][p.name] = predicate_out.size();
+			predicate_out.push_back(make_pair(false, &p));
 		}
-		assert(task_id.count(t.name) == 0);
-		task_id[t.name] = task_id.size();
-		task_out.push_back(make_pair(t,false));
 	}
 
+	map<string,int> function_declarations;
+	vector<const predicate_definition*> functions_out;
+	for (auto & [f, _] : parsed_functions){
+		if (f.name == metric_target) continue; // don't output the metric target, we don't need it
+		function_declarations[f.name] = functions_out.size();
+		functions_out.push_back(&f);
+	}
+
+	map<string,int> task_id;
+	for (const vector<task> * ts : {&primitive_tasks, &abstract_tasks})
+		for (const task & t : *ts){
+			if (task_id.count(t.name) != 0)
+				cerr << "Duplicate " << (ts == &primitive_tasks ? "primitive" : "abstract") << " task " << t.name << endl;
+			assert(task_id.count(t.name) == 0);
+			int id = task_id.size();
+			task_id[t.name] = id;
+		}
+
+	auto arguments_out = [&](const vector<string> & args, const map<string,int> & v_id){
+		for (const string & v : args) dout << " " << output_id(v_id, v);
+	};
+	auto sorts_out = [&](const vector<string> & ss){
+		for (const string & s : ss) dout << " " << output_id(sort_id, s);
+	};
+	// a literal of the "+" or "-" version of its predicate
+	auto literal_out = [&](const literal & l, bool positive, const map<string,int> & v_id){
+		dout << output_id(predicates[positive], l.predicate);
+		arguments_out(l.arguments, v_id);
+	};
+	auto variables_out = [&](const vector<pair<string,string>> & vars, map<string,int> & v_id){
+		for (auto & [v, s] : vars){
+			int id = v_id.size();
+			v_id[v] = id;
+			dout << output_id(sort_id, s) << " ";
+		}
+	};
+
 	// write domain to std out
 	dout << "#number_constants_number_sorts" << endl;
-	dout << constants.size() << " " << sorts.size() << endl;
+	dout << constants_out.size() << " " << sorts.size() << endl;
 	dout << "#constants" << endl;
-	for (string c : constants_out) dout << c << endl;
+	for (const string & c : constants_out) dout << c << endl;
 	dout << "#end_constants" << endl;
 	dout << "#sorts_each_with_number_of_members_and_members" << endl;
-	for(auto s : sort_out) {
-		dout << s.first << " " << s.second.size();
-		for (auto c : s.second) dout << " " << constants[c];
+	for (auto & [s, elems] : sorts) {
+		dout << s << " " << elems.size();
+		for (const string & c : elems) dout << " " << constants[c];
 		dout << endl;	
 	}
 	dout << "#end_sorts" << endl;
 	dout << "#number_of_predicates" << endl;
 	dout << predicate_out.size() << endl;
 	dout << "#predicates_each_with_number_of_arguments_and_argument_sorts" << endl;
-	for(auto p : predicate_out){
-		dout << p.first << " " << p.second.argument_sorts.size();
-		for(string s : p.second.argument_sorts) assert(sort_id.count(s)), dout << " " << sort_id[s];
+	for (auto [positive, p] : predicate_out){
+		dout << (positive ? "+" : "-") << p->name << " " << p->argument_sorts.size();
+		sorts_out(p->argument_sorts);
 		dout << endl;
 	}
 	dout << "#end_predicates" << endl;
 	
+	// + and - predicates are known mutexes ...
 	dout << "#begin_predicate_mutexes" << endl;
-	dout << mutexPredicates.size() << endl;
-	for (auto [one, two] : mutexPredicates){
-		dout << predicates[one] << " " << predicates[two] << endl; 
+	dout << predicates[false].size() << endl;
+	for (const predicate_definition & p : predicate_definitions) if (neg_pred.count(p.name)){
+		dout << predicates[true][p.name] << " " << predicates[false][p.name] << endl; 
 	}
 	dout << "#end_predicate_mutexes" << endl;
+
+	// the initial state contains the negative facts of these "-" predicates implicitly, i.e. all their instances whose "+" version is not in it
+	if (implicit_cwa){
+		vector<int> closed_world;
+		for (const string & p : closed_world_predicates){
+			auto it = predicates[false].find(p);
+			if (it != predicates[false].end()) closed_world.push_back(it->second);
+		}
+		dout << "#begin_closed_world_predicates" << endl;
+		dout << closed_world.size() << endl;
+		for (int p : closed_world) dout << p << endl;
+		dout << "#end_closed_world_predicates" << endl;
+	}
 	
 	
 	dout << "#number_of_functions" << endl;
-	dout << function_declarations.size() << endl;
+	dout << functions_out.size() << endl;
 	dout << "#function_declarations_with_number_of_arguments_and_argument_sorts" << endl;
-	for(auto f : functions_out){
-		dout << f.name << " " << f.argument_sorts.size();
-		for(string s : f.argument_sorts) assert(sort_id.count(s)), dout << " " << sort_id[s];
+	for (const predicate_definition * f : functions_out){
+		dout << f->name << " " << f->argument_sorts.size();
+		sorts_out(f->argument_sorts);
 		dout << endl;
 	}
 	
 	dout << "#number_primitive_tasks_and_number_abstract_tasks" << endl;
 	dout << primitive_tasks.size() << " " << abstract_tasks.size() << endl;
 
-	for (auto tt : task_out){
-		task t = tt.first;
+	for (const vector<task> * ts : {&primitive_tasks, &abstract_tasks}) for (const task & t : *ts){
 		dout << "#begin_task_name_number_of_original_variables_and_number_of_variables" << endl;
 		assert(int(t.vars.size()) >= t.number_of_original_vars);
 		dout << t.name << " " << t.number_of_original_vars << " " << t.vars.size() << endl;
 		dout << "#sorts_of_variables" << endl;
 		map<string,int> v_id;
-		for (auto v : t.vars) assert(sort_id.count(v.second)), dout << sort_id[v.second] << " ", v_id[v.first] = v_id.size();
+		variables_out(t.vars, v_id);
 		dout << endl;
 		dout << "#end_variables" << endl;
 
-		if (tt.second){
+		if (ts == &primitive_tasks){
 			dout << "#number_of_cost_statements" << endl;
 			if (instance_has_action_costs)
 				dout << t.costExpression.size() << endl;
@@ -249,12 +292,12 @@ void simple_hddl_output(ostream & dout){
 				dout << 1 << endl;
 			dout << "#begin_cost_statements" << endl;
 			if (instance_has_action_costs){
-				for (auto c : t.costExpression){
+				for (const literal & c : t.costExpression){
 					if (c.isConstantCostExpression)
 						dout << "const " << c.costValue << endl;
 					else {
-						dout << "var " << function_declarations[c.predicate];
-						for (string v : c.arguments) dout << " " << v_id[v];
+						dout << "var " << output_id(function_declarations, c.predicate);
+						arguments_out(c.arguments, v_id);
 						dout << endl;
 					}
 				}
@@ -264,16 +307,14 @@ void simple_hddl_output(ostream & dout){
 
 			dout << "#preconditions_each_predicate_and_argument_variables" << endl;
 			dout << t.prec.size() << endl;
-			for (literal l : t.prec){
-				string p = (l.positive ? "+" : "-") + l.predicate;
-				dout << predicates[p];
-				for (string v : l.arguments) dout << " " << v_id[v];
+			for (const literal & l : t.prec){
+				literal_out(l, l.positive, v_id);
 				dout << endl;
 			}
 	
 			// determine number of add and delete effects
 			int add = 0, del = 0;
-			for (literal l : t.eff){
+			for (const literal & l : t.eff){
 				if (neg_pred.count(l.predicate)) add++,del++;
 				else if (l.positive) add++;
 				else del++;
@@ -281,84 +322,95 @@ void simple_hddl_output(ostream & dout){
 
 			// count conditional add and delete effects
 			int cadd = 0, cdel = 0;
-			for (conditional_effect ceff : t.ceff) {
-				literal l = ceff.effect;
-				if (neg_pred.count(l.predicate)) cadd++,cdel++;
-				else if (l.positive) cadd++;
+			for (const conditional_effect & ceff : t.ceff) {
+				if (neg_pred.count(ceff.effect.predicate)) cadd++,cdel++;
+				else if (ceff.effect.positive) cadd++;
 				else cdel++;
 			}
 
-			dout << "#add_each_predicate_and_argument_variables" << endl;
-			dout << add << endl;
-			for (literal l : t.eff){
-				if (!neg_pred.count(l.predicate) && !l.positive) continue;
-				string p = (l.positive ? "+" : "-") + l.predicate;
-				dout << predicates[p];
-				for (string v : l.arguments) dout << " " << v_id[v];
-				dout << endl;
-			}
-
-			dout << "#conditional_add_each_with_conditions_and_effect" << endl;
-			dout << cadd << endl;
-			for (conditional_effect ceff : t.ceff) {
-				// if this is a delete effect and the "-" predicates is not necessary
-				if (!neg_pred.count(ceff.effect.predicate) && !ceff.effect.positive) continue;
-				// number of conditions
-				dout << ceff.condition.size();
-				for (literal l : ceff.condition){
-					string p = (l.positive ? "+" : "-") + l.predicate;
-					dout << "  "  << predicates[p]; // two spaces for better human readability
-					for (string v : l.arguments) dout << " " << v_id[v];
+			// the add effects of the "+" and "-" predicates are the delete effects of the other one
+			for (bool adds : {true, false}){
+				dout << (adds ? "#add_each_predicate_and_argument_variables" : "#del_each_predicate_and_argument_variables") << endl;
+				dout << (adds ? add : del) << endl;
+				for (const literal & l : t.eff){
+					if (!neg_pred.count(l.predicate) && l.positive != adds) continue;
+					literal_out(l, l.positive == adds, v_id);
+					dout << endl;
 				}
 
-				// effect
-				string p = (ceff.effect.positive ? "+" : "-") + ceff.effect.predicate;
-				dout << "  "  << predicates[p]; // two spaces for better human readability
-				for (string v : ceff.effect.arguments) dout << " " << v_id[v];
-
-				dout << endl;
-			}
+				dout << (adds ? "#conditional_add_each_with_conditions_and_effect" : "#conditional_del_each_with_conditions_and_effect") << endl;
+				dout << (adds ? cadd : cdel) << endl;
+				for (const conditional_effect & ceff : t.ceff) {
+					// if the other predicate is not necessary
+					if (!neg_pred.count(ceff.effect.predicate) && ceff.effect.positive != adds) continue;
+					// number of conditions
+					dout << ceff.condition.size();
+					for (const literal & l : ceff.condition){
+						dout << "  "; // two spaces for better human readability
+						literal_out(l, l.positive, v_id);
+					}
 
-			
-			dout << "#del_each_predicate_and_argument_variables" << endl;
-			dout << del << endl;
-			for (literal l : t.eff){
-				if (!neg_pred.count(l.predicate) && l.positive) continue;
-				string p = (l.positive ? "-" : "+") + l.predicate;
-				dout << predicates[p];
-				for (string v : l.arguments) dout << " " << v_id[v];
-				dout << endl;
-			}
+					// effect
+					dout << "  "; // two spaces for better human readability
+					literal_out(ceff.effect, ceff.effect.positive == adds, v_id);
 
-			dout << "#conditional_del_each_with_conditions_and_effect" << endl;
-			dout << cdel << endl;
-			for (conditional_effect ceff : t.ceff) {
-				// if this is an add effect and the "+" predicates is not necessary
-				if (!neg_pred.count(ceff.effect.predicate) && ceff.effect.positive) continue;
-				// number of conditions
-				dout << ceff.condition.size();
-				for (literal l : ceff.condition){
-					string p = (l.positive ? "+" : "-") + l.predicate;
-					dout << "  "  << predicates[p]; // two spaces for better human readability
-					for (string v : l.arguments) dout << " " << v_id[v];
+					dout << endl;
 				}
-
-				// effect
-				string p = (ceff.effect.positive ? "-" : "+") + ceff.effect.predicate;
-				dout << "  "  << predicates[p]; // two spaces for better human readability
-				for (string v : ceff.effect.arguments) dout << " " << v_id[v];
-
-				dout << endl;
 			}
 
 	
 			dout << "#variable_constraints_first_number_then_individual_constraints" << endl;
 			dout << t.constraints.size() << endl;
-			for (literal l : t.constraints){
+			for (const literal & l : t.constraints){
 				if (!l.positive) dout << "!";
-				dout << "= " << v_id[l.arguments[0]] << " " << v_id[l.arguments[1]] << endl;
-				assert(l.arguments[0][0] == '?'); // cannot be a constant
-				assert(l.arguments[1][0] == '?'); // cannot be a constant
+				dout << "=";
+				arguments_out(l.arguments, v_id);
+				dout << endl;
+			}
+
+			// lifted universal quantifiers, only written if they are kept lifted. Their variables are numbered after those of the task
+			if (keep_forall_lifted){
+				// adds is -1 for conditions, whose literals are written as they are
+				auto literals_out = [&](const vector<literal> & ls, int adds, const map<string,int> & q_id){
+					int n = 0;
+					for (const literal & l : ls)
+						if (adds == -1 || neg_pred.count(l.predicate) || l.positive == adds) n++;
+					dout << "  " << n;
+					for (const literal & l : ls){
+						if (adds != -1 && !neg_pred.count(l.predicate) && l.positive != adds) continue;
+						dout << "  ";
+						literal_out(l, adds == -1 ? l.positive : l.positive == adds, q_id);
+					}
+				};
+				auto quantified_out = [&](const quantified_literals & q, map<string,int> & q_id){
+					q_id = v_id;
+					dout << q.vars.size();
+					for (auto & [v, s] : q.vars){
+						int id = q_id.size();
+						q_id[v] = id;
+						dout << " " << output_id(sort_id, s);
+					}
+				};
+
+				dout << "#universal_preconditions_each_with_quantified_variable_sorts_and_literals" << endl;
+				dout << t.forall_prec.size() << endl;
+				for (const quantified_literals & q : t.forall_prec){
+					map<string,int> q_id;
+					quantified_out(q, q_id);
+					literals_out(q.literals, -1, q_id);
+					dout << endl;
+				}
+
+				dout << "#universal_effects_each_with_quantified_variable_sorts_conditions_adds_and_deletes" << endl;
+				dout << t.forall_eff.size() << endl;
+				for (const quantified_literals & q : t.forall_eff){
+					map<string,int> q_id;
+					quantified_out(q, q_id);
+					literals_out(q.condition, -1, q_id);
+					literals_out(q.literals, true, q_id);
+					literals_out(q.literals, false, q_id);
+					dout << endl;
+				}
 			}
 		}
 		dout << "#end_of_task" << endl;
@@ -367,75 +419,90 @@ void simple_hddl_output(ostream & dout){
 	dout << "#number_of_methods" << endl;
 	dout << methods.size() << endl;
 
-	for (method m : methods){
+	for (const method & m : methods){
 		dout << "#begin_method_name_abstract_task_number_of_variables" << endl;
-		dout << m.name << " " << task_id[m.at] << " " << m.vars.size() << endl;
+		dout << m.name << " " << output_id(task_id, m.at) << " " << m.vars.size() << endl;
 		dout << "#variable_sorts" << endl;
 		map<string,int> v_id;
-		for (auto v : m.vars) assert(sort_id.count(v.second)), dout << sort_id[v.second] << " ", v_id[v.first] = v_id.size();
+		variables_out(m.vars, v_id);
 		dout << endl;
 		dout << "#parameter_of_abstract_task" << endl;
-		for (string v : m.atargs) dout << v_id[v] << " ";
+		for (const string & v : m.atargs) dout << output_id(v_id, v) << " ";
 		dout << endl;
 		dout << "#number_of_subtasks" << endl;
 		dout << m.ps.size() << endl;
 		dout << "#subtasks_each_with_task_id_and_parameter_variables" << endl;
 		map<string,int> ps_id;
-		for (plan_step ps : m.ps){
-			ps_id[ps.id] = ps_id.size();
-			dout << task_id[ps.task];
-			for (string v : ps.args) dout << " " << v_id[v];
+		for (const plan_step & ps : m.ps){
+			int id = ps_id.size();
+			ps_id[ps.id] = id;
+			dout << output_id(task_id, ps.task);
+			arguments_out(ps.args, v_id);
 			dout << endl;
 		}
 		dout << "#number_of_ordering_constraints_and_ordering" << endl;
 		dout << m.ordering.size() << endl;
-		for (auto o : m.ordering) dout << ps_id[o.first] << " " << ps_id[o.second] << endl;
+		for (auto & [before, after] : m.ordering)
+			dout << output_id(ps_id, before) << " " << output_id(ps_id, after) << endl;
 
 		dout << "#variable_constraints" << endl;
 		dout << m.constraints.size() << endl;
-		for (literal l : m.constraints){
+		for (const literal & l : m.constraints){
 			if (!l.positive) dout << "!";
-			dout << "= " << v_id[l.arguments[0]] << " " << v_id[l.arguments[1]] << endl;
-			assert(l.arguments[1][0] == '?'); // cannot be a constant
+			dout << "=";
+			arguments_out(l.arguments, v_id);
+			dout << endl;
 		}
 		dout << "#end_of_method" << endl;
 	}
-
 	dout << "#init_and_goal_facts" << endl;
 	dout << init.size() << " " << goal.size() << endl;
-	for (auto gl : init){
-		string pn = (gl.positive ? "+" : "-") + gl.predicate;
-		assert(predicates.count(pn) != 0);
-		dout << predicates[pn];
-		for (string c : gl.args) dout << " " << constants[c];
-		dout << endl;
+	// output the facts column-wise, translating the ids of the store into those of the output
+	vector<int> init_constants;
+	for (const string & c : init.constants){
+		auto it = constants.find(c);
+		init_constants.push_back(it == constants.end() ? -1 : it->second);
+	}
+	for (auto & [predicate, facts] : init.predicates) for (bool pos : {true, false}){
+		if (facts.number_of_facts(pos) == 0) continue;
+		int p = output_id(predicates[pos], predicate);
+		const vector<int> & column = pos ? facts.positive : facts.negative;
+		for (size_t f = 0; f < facts.number_of_facts(pos); f++){
+			dout << p;
+			for (int i = 0; i < facts.arity; i++){
+				if (init_constants[column[f * facts.arity + i]] == -1){
+					cerr << "\x1b[31mError\x1b[0m: the initial fact over " << predicate << " uses the constant " << init.constants[column[f * facts.arity + i]] << ", which is not part of the model." << endl;
+					exit(1);
+				}
+				dout << " " << init_constants[column[f * facts.arity + i]];
+			}
+			dout << endl;
+		}
 	}
 	dout << "#end_init" << endl;
-	for (auto gl : goal){
-		string pn = (gl.positive ? "+" : "-") + gl.predicate;
-		assert(predicates.count(pn) != 0);
-		dout << predicates[pn];
-		for (string c : gl.args) dout << " " << constants[c];
+	for (const ground_literal & gl : goal){
+		dout << output_id(predicates[gl.positive], gl.predicate);
+		for (const string & c : gl.args) dout << " " << output_id(constants, c);
 		dout << endl;
 	}
 	dout << "#end_goal" << endl;
 	dout << "#init_function_facts" << endl;
 	vector<string> function_lines;
-	for (auto f : init_functions){
-		if (f.first.predicate == metric_target){
+	for (auto & [f, value] : init_functions){
+		if (f.predicate == metric_target){
 			cerr << "Ignoring initialisation of metric target \"" << metric_target << "\"" << endl;
 			continue;
 		}
-		string line = to_string(function_declarations[f.first.predicate]);
-		for (auto c : f.first.args) line += " " + to_string(constants[c]);
-		line += " " + to_string(f.second);
+		string line = to_string(output_id(function_declarations, f.predicate));
+		for (const string & c : f.args) line += " " + to_string(output_id(constants, c));
+		line += " " + to_string(value);
 		function_lines.push_back(line);
 	}
 	dout << function_lines.size() << endl;
-	for (string l : function_lines)
+	for (const string & l : function_lines)
 		dout << l << endl;
 
 	dout << "#initial_task" << endl;
 	if (instance_is_classical) dout << "-1" << endl;
-	else dout << task_id["__top"] << endl;
+	else dout << output_id(task_id, "__top") << endl;
 }
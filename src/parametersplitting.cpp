@@ -13,6 +13,8 @@ void split_independent_parameters(){
 	for (task & prim : primitive_tasks) {
 		for (literal & l : prim.eff) staticPredicates.erase(l.predicate);
 		for (conditional_effect & ce : prim.ceff) staticPredicates.erase(ce.effect.predicate);
+		for (quantified_literals & q : prim.forall_eff)
+			for (literal & l : q.literals) staticPredicates.erase(l.predicate);
 	}
 
 
@@ -22,6 +24,8 @@ void split_independent_parameters(){
 		cout << s << endl;
 #endif	
 
+	// whether a method is known to have no splittable variable. It stays that way, as the splitting only adds new tasks and methods
+	vector<bool> unsplittable(methods.size(), false);
 	bool splittedSomeMethod = true;
 	int i = 0;
 	while (splittedSomeMethod){
@@ -29,18 +33,27 @@ void split_independent_parameters(){
 	
 		set<string> artificialTasks;
 		for (task & prim : primitive_tasks)
-			if (prim.artificial && prim.eff.size() == 0 && prim.ceff.size() == 0) // no effects ...
+			if (prim.artificial && prim.eff.size() == 0 && prim.ceff.size() == 0 && prim.forall_prec.size() == 0 && prim.forall_eff.size() == 0) // no effects ...
 				artificialTasks.insert(prim.name);
 		
 		
-		vector<method> old = methods;
+		vector<method> old = move(methods);
+		vector<bool> oldUnsplittable = move(unsplittable);
 		methods.clear();
-		for(method m : old){
+		unsplittable.clear();
+		auto keep = [&](method & m){
+			methods.push_back(move(m));
+			unsplittable.push_back(true);
+		};
+		for (size_t mi = 0; mi < old.size(); mi++){
+			method & m = old[mi];
+			if (oldUnsplittable[mi]) { keep(m); continue; }
+
 			// find variables that occur only in one of the plan steps
 			map<string,set<pair<string,int>>> variables_ps_id;
-			for(plan_step ps : m.ps) {
+			for(const plan_step & ps : m.ps) {
 				if (!artificialTasks.count(ps.task))
-					for(string v : ps.args) variables_ps_id[v].insert({ps.id,-1});
+					for(const string & v : ps.args) variables_ps_id[v].insert({ps.id,-1});
 				else {
 					set<string> vars_in_non_static;
 					int pCount = 0;
@@ -88,13 +101,13 @@ void split_independent_parameters(){
 			for (literal l : m.constraints) variables_ps_id.erase(l.arguments[0]), variables_ps_id.erase(l.arguments[1]);
 	
 			// no variables can be splitted
-			if (variables_ps_id.size() == 0) { methods.push_back(m); continue; }
+			if (variables_ps_id.size() == 0) { keep(m); continue; }
 	
 
 			string largestSplittable = "";
 			// check for every splittable variable whether we can split it away.
 			set<string> beforeID, afterID;
-			for (auto [vps,ss] : variables_ps_id) {
+			for (auto & [vps,ss] : variables_ps_id) {
 				set<string> ordered_ps;
 				set<string> all_ps;
 				// we can ignore order for static predicates on artificial tasks
@@ -120,7 +133,7 @@ void split_independent_parameters(){
 				}	
 			}
 	
-			if (largestSplittable == "") { methods.push_back(m); continue; }
+			if (largestSplittable == "") { keep(m); continue; }
 
 			splittedSomeMethod = true;
 
@@ -180,7 +193,7 @@ void split_independent_parameters(){
 			
 			set<string> splittedIDs;
 			// put the plan steps in their respective methods
-			for (plan_step ops : m.ps){
+			for (plan_step & ops : m.ps){
 				// check if this an artificial task which we may have to split
 				set<int> splitPrecs;
 				set<string> haveMinusOne;
@@ -196,11 +209,11 @@ void split_independent_parameters(){
 				}
 	
 				if (splitPrecs.size() == 0)	{
-					if (!isSub) base.ps.push_back(ops);
-					else sm.ps.push_back(ops);
+					if (!isSub) base.ps.push_back(move(ops));
+					else sm.ps.push_back(move(ops));
 				} else {
 					// this is an artificial task that needs splitting
-					task tMain = task_name_map[ops.task];
+					const task & tMain = task_name_map[ops.task];
 					task tBase; plan_step pBase;
 					task tSub;  plan_step pSub;
 					pBase.id = ops.id;
@@ -273,11 +286,11 @@ void split_independent_parameters(){
 					tBase.check_integrity();
 					tSub.check_integrity();
 
-					primitive_tasks.push_back(tBase); task_name_map[tBase.name] = tBase;
-					primitive_tasks.push_back(tSub);  task_name_map[tSub.name] = tSub;
+					task_name_map[tBase.name] = tBase; primitive_tasks.push_back(move(tBase));
+					task_name_map[tSub.name] = tSub;   primitive_tasks.push_back(move(tSub));
 					
-					base.ps.push_back(pBase);
-					sm.ps.push_back(pSub);
+					base.ps.push_back(move(pBase));
+					sm.ps.push_back(move(pSub));
 				}
 			}
 
@@ -291,18 +304,18 @@ void split_independent_parameters(){
 				if (c == 2)	sm.ordering.push_back({b,a});
 			}
 	
-			for (plan_step ps : sm.ps){
+			for (const plan_step & ps : sm.ps){
 				if (splittedIDs.count(ps.id)) continue;
-				for (string id : splittedIDs)
+				for (const string & id : splittedIDs)
 					sm.ordering.push_back({id,ps.id});
 			}
 	
 			// nps is the plan steps that is inserted into the base method
 			plan_step nps;
 			set<string> npsVars; // duplicate check
-			for (plan_step ps : sm.ps){
+			for (const plan_step & ps : sm.ps){
 				// variables
-				for (string v : ps.args){	
+				for (const string & v : ps.args){	
 					// if we don't remove it, it is an argument of the abstract task
 					string sort; 
 					if (!variables_to_remove.count(v)){
@@ -325,11 +338,11 @@ void split_independent_parameters(){
 			// the new abstract task is done so push it
 			at.number_of_original_vars = at.vars.size(); // does not matter as it will get pruned
 			at.check_integrity();
-			abstract_tasks.push_back(at);
 			task_name_map[at.name] = at;
+			abstract_tasks.push_back(move(at));
 	
 			// add the new plan step to the base method	
-			nps.task = at.name;
+			nps.task = sm.at;
 			nps.id = "x_split_" + to_string(i);
 			for (string b : beforeID) base.ordering.push_back({b,nps.id});
 			for (string a : afterID) base.ordering.push_back({nps.id,a});
@@ -341,13 +354,15 @@ void split_independent_parameters(){
 			cout << "Checking splitting method" << endl;
 #endif
 			sm.check_integrity();
-			methods.push_back(sm);
+			methods.push_back(move(sm));
+			unsplittable.push_back(false);
 	
 #ifndef NDEBUG
 			cout << "Checking base method" << endl;
 #endif
 			base.check_integrity();
-			methods.push_back(base);
+			methods.push_back(move(base));
+			unsplittable.push_back(false);
 		}
 		//break;
 	}	
@@ -0,0 +1,90 @@
+#ifndef __PARSER
+#define __PARSER
+
+#include <cstdio>
+#include <functional>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "parsetree.hpp"
+#include "cwa.hpp"
+#include "compression.hpp"
+
+using namespace std;
+
+// identifiers are interned by the scanner, i.e. a token is a pointer to the only copy of its name instead of a string of its own. The parse tree (var_and_const,
+// general_formula, parsed_task, ...) still stores std::string, so each occurrence of a name is copied once when it is stored there. Only the :init section is
+// stored without these copies (see init_constant_ids)
+class symbol_table{
+	public:
+		symbol_table() = default;
+		symbol_table(const symbol_table &) = delete;
+		~symbol_table();
+		const char* intern(const char* s, size_t len);
+	private:
+		unordered_map<string_view,const char*> symbols;
+		vector<char*> blocks;
+		char* block_pos = NULL;
+		size_t block_free = 0;
+};
+
+// position of an :init section that has not been parsed, but is read again from its file for the output (see find_init_section)
+struct init_section{
+	string file_name;
+	size_t begin = 0; // the opening parenthesis
+	size_t body = 0;  // the first element
+	size_t end = 0;   // just after the closing parenthesis
+};
+
+// everything a single run of the parser produces. The parser never touches the global data structures directly, s.t. multiple files can be parsed at the same time.
+struct parse_context{
+	string file_name;
+	int task_id_counter = 0;
+	bool sort_object_needed = false;
+	symbol_table symbols;
+	// the scanner reads through this if the file is not scanned in memory, e.g. if it is compressed
+	decompressing_reader* input = NULL;
+
+	bool has_typeof_predicate = false;
+	vector<sort_definition> sort_definitions;
+	vector<predicate_definition> predicate_definitions;
+	vector<parsed_task> parsed_primitive;
+	vector<parsed_task> parsed_abstract;
+	map<string,vector<parsed_method> > parsed_methods;
+	vector<pair<predicate_definition,string>> parsed_functions;
+	string metric_target = dummy_function_type;
+	map<string,set<string> > sorts;
+
+	fact_store init;
+	// the :init section is added to init by the interned names of its constants and predicates, i.e. only the first occurrence of a name is copied
+	unordered_map<const char*,int> init_constant_ids;
+	unordered_map<const char*,predicate_facts*> init_predicates;
+	vector<int> init_args;
+	vector<pair<ground_literal,int>> init_functions;
+	general_formula* goal_formula = NULL;
+	// set if the :init section has been skipped, see stream_init_sections
+	init_section streamed_init;
+};
+
+// if set, plain :init sections of problems are not parsed, but are streamed to the output by hddl_output
+extern bool stream_init_sections;
+extern init_section streamed_init;
+
+// parses the file into its own context
+void parse_file(FILE* f, const char* filename, parse_context & ctx);
+// appends the contents of the context to the global data structures
+void merge_parse_context(parse_context & ctx);
+
+// parses a single file and merges its contents into the global data structures
+void run_parser_on_file(FILE* f, char* filename);
+// parses the domain, or reads it from the snapshot in cache_dir if there is one (and writes the snapshot otherwise)
+void parse_domain_file(FILE* f, const char* filename, parse_context & ctx, const char* cache_dir);
+// parses domain and problem on two threads and merges them (in this order) into the global data structures. If domain_cache is given, the domain is taken from the cache.
+// domain_parsed is run on the context of the domain as soon as it is complete, i.e. while the problem may still be parsed
+void run_parser_on_files(FILE* domain, char* domain_name, FILE* problem, char* problem_name, const char* domain_cache = NULL,
+		const function<void(parse_context &)> & domain_parsed = nullptr);
+
+#endif
@@ -2,8 +2,111 @@
 #include "cwa.hpp"
 #include <iostream>
 #include <cassert>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+
+// formulae are created in large numbers and are never freed individually. They are placed into blocks of an arena that is released at once
+const size_t FORMULA_BLOCK_SIZE = 4096;
+
+struct formula_slot{
+	alignas(general_formula) unsigned char node[sizeof(general_formula)];
+	bool alive;
+};
+
+struct formula_block{
+	formula_slot slots[FORMULA_BLOCK_SIZE];
+	size_t used = 0;
+};
+
+mutex formula_arena_mutex;
+vector<formula_block*> formula_blocks;
+// every thread fills its own block. A thread's block is invalid once the arena has been released
+atomic<int> formula_arena_generation(0);
+thread_local int current_formula_generation = -1;
+thread_local formula_block* current_formula_block = NULL;
+
+void* general_formula::operator new(size_t size){
+	assert(size == sizeof(general_formula));
+	if (current_formula_generation != formula_arena_generation || current_formula_block->used == FORMULA_BLOCK_SIZE){
+		current_formula_block = new formula_block;
+		current_formula_generation = formula_arena_generation;
+		lock_guard<mutex> lock(formula_arena_mutex);
+		formula_blocks.push_back(current_formula_block);
+	}
+	formula_slot* slot = current_formula_block->slots + current_formula_block->used++;
+	slot->alive = true;
+	return slot->node;
+}
+
+void general_formula::operator delete(void* p){
+	// the destructor has already run, the memory itself is reclaimed with the arena
+	((formula_slot*) p)->alive = false;
+}
+
+void release_formula_arena(){
+	lock_guard<mutex> lock(formula_arena_mutex);
+	for (formula_block* block : formula_blocks){
+		for (size_t i = 0; i < block->used; i++)
+			if (block->slots[i].alive)
+				((general_formula*) block->slots[i].node)->~general_formula();
+		delete block;
+	}
+	formula_blocks.clear();
+	formula_arena_generation++;
+}
+
+const var_and_const no_arguments;
+const var_declaration no_qvariables;
+const string no_arg;
 
-int task_id_counter = 0;
+const var_and_const & general_formula::arguments() const{
+	auto f = get_if<var_and_const>(&fields);
+	return f ? *f : no_arguments;
+}
+
+const var_declaration & general_formula::qvariables() const{
+	auto f = get_if<var_declaration>(&fields);
+	return f ? *f : no_qvariables;
+}
+
+const string & general_formula::arg1() const{
+	auto f = get_if<pair<string,string>>(&fields);
+	return f ? f->first : no_arg;
+}
+
+const string & general_formula::arg2() const{
+	auto f = get_if<pair<string,string>>(&fields);
+	return f ? f->second : no_arg;
+}
+
+var_and_const & general_formula::mutable_arguments(){
+	if (!holds_alternative<var_and_const>(fields)) fields.emplace<var_and_const>();
+	return get<var_and_const>(fields);
+}
+
+var_declaration & general_formula::mutable_qvariables(){
+	if (!holds_alternative<var_declaration>(fields)) fields.emplace<var_declaration>();
+	return get<var_declaration>(fields);
+}
+
+pair<string,string> & general_formula::mutable_args(){
+	if (!holds_alternative<pair<string,string>>(fields)) fields.emplace<pair<string,string>>();
+	return get<pair<string,string>>(fields);
+}
+
+size_t general_formula::fields_kind() const{
+	return fields.index();
+}
+
+bool general_formula::same_fields(const general_formula & other) const{
+	if (fields.index() != other.fields.index()) return false;
+	if (auto a = get_if<var_and_const>(&fields)) return a->vars == get<var_and_const>(other.fields).vars && a->newVar == get<var_and_const>(other.fields).newVar;
+	if (auto q = get_if<var_declaration>(&fields)) return q->vars == get<var_declaration>(other.fields).vars;
+	if (auto a = get_if<pair<string,string>>(&fields)) return *a == get<pair<string,string>>(other.fields);
+	return true;
+}
 
 void general_formula::negate(){
 	if (this->type == EMPTY) return;
@@ -24,6 +127,15 @@ void general_formula::negate(){
 }
 
 
+general_formula* general_formula::negatedCopy(){
+	general_formula* ret = new general_formula(*this);
+	ret->subformulae.clear();
+	ret->negate();
+	for (auto sub : this->subformulae) ret->subformulae.push_back(sub->negatedCopy());
+	return ret;
+}
+
+
 bool general_formula::isEmpty(){
 	if (this->type == EMPTY) return true;
 
@@ -68,7 +180,18 @@ bool general_formula::hasForall(){
 	return false;
 }
 
+// results of precompute_domain_lowering. The map itself is not changed during lowering, s.t. actions can be lowered on several threads
+struct precomputed_expansion{
+	vector<formula_branch> branches;
+	atomic<bool> taken{false};
+};
+map<pair<general_formula*,bool>, precomputed_expansion> precomputed_expansions;
+map<general_formula*, set<string> > precomputed_variables;
+
 set<string> general_formula::occuringUnQuantifiedVariables(){
+	auto pre = precomputed_variables.find(this);
+	if (pre != precomputed_variables.end()) return pre->second;
+
 	set<string> ret;
 
 	if (this->type == EMPTY) return ret;
@@ -84,7 +207,7 @@ set<string> general_formula::occuringUnQuantifiedVariables(){
 	if (this->type == FORALL || this->type == EXISTS) {
 		set<string> subres = this->subformulae[0]->occuringUnQuantifiedVariables();
 
-		for (auto [var,_] : this->qvariables.vars){
+		for (auto [var,_] : this->qvariables().vars){
 			subres.erase(var);
 		}
 
@@ -92,14 +215,14 @@ set<string> general_formula::occuringUnQuantifiedVariables(){
 	}
 
 	if (this->type == ATOM || this->type == NOTATOM){
-		ret.insert(this->arguments.vars.begin(), this->arguments.vars.end());
+		ret.insert(this->arguments().vars.begin(), this->arguments().vars.end());
 		return ret;
 	}
 	
 	if (this->type == EQUAL || this->type == NOTEQUAL || 
 			this->type == OFSORT || this->type == NOTOFSORT){
-		ret.insert(this->arg1);
-		ret.insert(this->arg2);
+		ret.insert(this->arg1());
+		ret.insert(this->arg2());
 		return ret;
 	}
 
@@ -116,7 +239,7 @@ set<string> general_formula::occuringUnQuantifiedVariables(){
 
 additional_variables general_formula::variables_for_constants(){
 	additional_variables ret;
-	ret.insert(this->arguments.newVar.begin(),this->arguments.newVar.end());
+	ret.insert(this->arguments().newVar.begin(),this->arguments().newVar.end());
 	for (general_formula* sf : this->subformulae){
 		additional_variables sfr = sf->variables_for_constants();
 		ret.insert(sfr.begin(),sfr.end());
@@ -124,33 +247,91 @@ additional_variables general_formula::variables_for_constants(){
 	return ret;
 }
 
-string sort_for_const(string c){
+// actions are lowered on several threads, which all may add sorts for constants
+mutex sorts_for_constants_mutex;
+
+string sort_for_const_unlocked(string c){
 	string s = "sort_for_" + c;
 	sorts[s].insert(c);
 	return s;
 }
 
-general_formula* general_formula::copyReplace(map<string,string> & replace){
-	general_formula* ret = new general_formula();
-	ret->type = this->type;
-	ret->qvariables = this->qvariables;
-	ret->arg1 = this->arg1;
-	if (replace.count(ret->arg1)) ret->arg1 = replace[ret->arg1];
-	ret->arg2 = this->arg2;
-	if (replace.count(ret->arg2)) ret->arg2 = replace[ret->arg2];
-	ret->value = this->value;
-
-	ret->predicate = this->predicate;
-	for (auto sub : this->subformulae) ret->subformulae.push_back(sub->copyReplace(replace));
-	
-	ret->arguments = this->arguments;
-	for(unsigned int i = 0; i < ret->arguments.vars.size(); i++)
-		if (replace.count(ret->arguments.vars[i]))
-				ret->arguments.vars[i] = replace[ret->arguments.vars[i]];
-	
+string sort_for_const(string c){
+	lock_guard<mutex> lock(sorts_for_constants_mutex);
+	return sort_for_const_unlocked(c);
+}
+
+// formulae created by replacing variables are hash-consed, i.e. structurally equal nodes (with the same children) are created only once and shared.
+// Instances of quantified formulae thus only allocate the parts that actually depend on the quantified variables
+size_t hash_combine(size_t h, size_t v){
+	return h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
+struct formula_node_hash{
+	size_t operator()(const general_formula* f) const{
+		hash<string> hs;
+		size_t h = hash_combine(f->type, f->value);
+		h = hash_combine(h, hs(f->predicate));
+		h = hash_combine(h, hs(f->arg1()));
+		h = hash_combine(h, hs(f->arg2()));
+		for (const string & v : f->arguments().vars) h = hash_combine(h, hs(v));
+		for (auto & [v,s] : f->qvariables().vars) h = hash_combine(hash_combine(h, hs(v)), hs(s));
+		for (general_formula* sub : f->subformulae) h = hash_combine(h, hash<general_formula*>()(sub));
+		return h;
+	}
+};
+
+// children are compared by identity, they are hash-consed already
+struct formula_node_equal{
+	bool operator()(const general_formula* a, const general_formula* b) const{
+		return a->type == b->type && a->value == b->value && a->predicate == b->predicate && a->same_fields(*b) && a->subformulae == b->subformulae;
+	}
+};
+
+mutex interned_formulae_mutex;
+unordered_set<general_formula*, formula_node_hash, formula_node_equal> interned_formulae;
+
+general_formula* intern_formula(general_formula & f){
+	lock_guard<mutex> lock(interned_formulae_mutex);
+	auto it = interned_formulae.find(&f);
+	if (it != interned_formulae.end()) return *it;
+	general_formula* ret = new general_formula(move(f));
+	interned_formulae.insert(ret);
 	return ret;
 }
 
+general_formula* general_formula::copyReplace(map<string,string> & replace){
+	general_formula ret = general_formula();
+	bool changed = false;
+	auto replace_var = [&](string & v){
+		auto it = replace.find(v);
+		if (it == replace.end()) return;
+		v = it->second;
+		changed = true;
+	};
+
+	ret.type = this->type;
+	ret.fields = this->fields;
+	if (auto args = get_if<pair<string,string>>(&ret.fields)){
+		replace_var(args->first);
+		replace_var(args->second);
+	}
+	if (auto args = get_if<var_and_const>(&ret.fields))
+		for (string & v : args->vars) replace_var(v);
+	ret.value = this->value;
+
+	ret.predicate = this->predicate;
+	for (auto sub : this->subformulae){
+		ret.subformulae.push_back(sub->copyReplace(replace));
+		if (ret.subformulae.back() != sub) changed = true;
+	}
+
+
+	// nothing depends on the replaced variables, the formula itself can be shared
+	if (!changed) return this;
+	return intern_formula(ret);
+}
+
 bool general_formula::isDisjunctive(){
 	if (this->type == EMPTY) return false;
 	else if (this->type == EQUAL) return false;
@@ -171,140 +352,346 @@ bool general_formula::isDisjunctive(){
 	return false;
 }
 
-int global_exists_variable_counter = 0;
+// structural equality. Cost statements are never considered equal, s.t. they are not merged
+bool same_formula(general_formula* a, general_formula* b){
+	if (a->type != b->type || a->type == VALUE || a->type == COST || a->type == COST_CHANGE) return false;
+	if (a == b) return true;
+	if (a->type == EQUAL || a->type == NOTEQUAL)
+		return (a->arg1() == b->arg1() && a->arg2() == b->arg2()) || (a->arg1() == b->arg2() && a->arg2() == b->arg1());
+	if (a->predicate != b->predicate || !a->same_fields(*b) || a->subformulae.size() != b->subformulae.size()) return false;
+	for (size_t i = 0; i < a->subformulae.size(); i++)
+		if (!same_formula(a->subformulae[i], b->subformulae[i])) return false;
+	return true;
+}
 
-// hard expansion of formulae. This can grow up to exponentially, but is currently the only thing we can do about disjunctions.
-// this will also handle forall and exists quantors by expansion
-// sorts must have been parsed and expanded prior to this call
-vector<pair<pair<vector<variant<literal,conditional_effect>>,vector<literal> >, additional_variables> > general_formula::expand(bool compileConditionalEffects){
-	vector<pair<pair<vector<variant<literal,conditional_effect>>,vector<literal> >, additional_variables> > ret;
+bool is_constant(const string & arg){
+	return arg[0] != '?';
+}
 
-	if (this->type == EMPTY || (this->subformulae.size() == 0 &&
-				(this->type == AND || this->type == OR || this->type == FORALL || this->type == EXISTS))){
-		vector<variant<literal,conditional_effect>> empty1;
-		vector<literal> empty2;
-		additional_variables none;
-		ret.push_back(make_pair(make_pair(empty1,empty2),none));
-		return ret;
+// there is no formula for false, an equality that can never hold is used instead. It makes the task or method unsatisfiable once its constraints are reduced
+bool general_formula::isFalse(){
+	if (this->type == NOTEQUAL) return this->arg1() == this->arg2();
+	if (this->type == EQUAL) return this->arg1() != this->arg2() && is_constant(this->arg1()) && is_constant(this->arg2());
+	return false;
+}
+
+// an unsatisfiable literal over one of the arguments of the literal. Returns false if it has none
+bool false_literal_for(general_formula* l, general_formula* & f){
+	string arg;
+	if (l->type == EQUAL || l->type == NOTEQUAL) arg = l->arg1();
+	else if (l->arguments().vars.size()){
+		arg = l->arguments().vars[0];
+		for (auto & [v, _] : l->arguments().newVar)
+			if (v == arg) arg = arg.substr(string("?var_for_").size()); // the variable only stands for a constant
+	} else return false;
+	f = new general_formula();
+	f->type = NOTEQUAL;
+	f->mutable_args() = make_pair(arg, arg);
+	return true;
+}
+
+bool complementary_literals(general_formula* a, general_formula* b){
+	if (a->type == ATOM && b->type == NOTATOM) return a->predicate == b->predicate && a->arguments().vars == b->arguments().vars;
+	if (a->type == NOTATOM && b->type == ATOM) return complementary_literals(b, a);
+	if ((a->type == EQUAL && b->type == NOTEQUAL) || (a->type == NOTEQUAL && b->type == EQUAL)){
+		general_formula c = *b;
+		c.type = a->type;
+		return same_formula(a, &c);
 	}
+	return false;
+}
 
-	// generate a big conjunction for forall and expand it
-	if (this->type == FORALL){
-		general_formula and_formula;
-		and_formula.type = AND;
-		auto [var_replace,avs] = forallVariableReplacement();
+void general_formula::simplify(bool effect, bool fold_false){
+	if (this->type == WHEN){
+		this->subformulae[0]->simplify(false);
+		this->subformulae[1]->simplify(true);
+		// an effect that never happens
+		if (this->subformulae[0]->isFalse()) { this->type = EMPTY; this->subformulae.clear(); }
+		return;
+	}
+	for (auto sub : this->subformulae) sub->simplify(effect, fold_false && this->type != FORALL && this->type != EXISTS);
 
-		for (auto r : var_replace)
-			and_formula.subformulae.push_back(this->subformulae[0]->copyReplace(r));
+	if (this->type == FORALL && this->subformulae[0]->type == EMPTY) { this->type = EMPTY; this->subformulae.clear(); }
+	if (effect && this->type != AND) return;
 
-		ret = and_formula.expand(compileConditionalEffects);
-		// add variables
-		for (unsigned int i = 0; i < ret.size(); i++)
-				ret[i].second.insert(avs.begin(), avs.end());
+	if (this->type == EQUAL && this->arg1() == this->arg2()) this->type = EMPTY;
+	if (this->type == NOTEQUAL && this->arg1() != this->arg2() && is_constant(this->arg1()) && is_constant(this->arg2())) this->type = EMPTY;
+	if (this->type != AND && this->type != OR) return;
+
+	// flatten nested conjunctions or disjunctions, remove true and false, and remove duplicates
+	vector<general_formula*> subs;
+	for (auto sub : this->subformulae){
+		if (sub->type == this->type) subs.insert(subs.end(), sub->subformulae.begin(), sub->subformulae.end());
+		else subs.push_back(sub);
 	}
 
+	general_formula* first_false = NULL;
+	vector<general_formula*> kept;
+	for (auto sub : subs){
+		if (sub->type == EMPTY){
+			if (this->type == AND) continue;
+			this->type = EMPTY; // a disjunction with true
+			this->subformulae.clear();
+			return;
+		}
+		if (!effect && sub->isFalse()){
+			if (this->type == AND) { *this = *sub; return; }
+			if (!first_false) first_false = sub;
+			continue;
+		}
+		bool duplicate = false;
+		for (auto k : kept) if (same_formula(k, sub)) duplicate = true;
+		if (!duplicate) kept.push_back(sub);
+	}
 
-	// add additional variables for every quantified variable. We have to do this for every possible instance of the precondition below	
-	if (this->type == EXISTS){
-		map<string,string> var_replace = existsVariableReplacement();
-		this->subformulae[0] = this->subformulae[0]->copyReplace(var_replace);
+	if (!effect){
+		// a literal and its negation: a conjunction is false and a disjunction is true
+		for (auto a : kept) for (auto b : kept){
+			if (!complementary_literals(a, b)) continue;
+			if (this->type == OR) { this->type = EMPTY; this->subformulae.clear(); return; }
+			general_formula* f;
+			if (fold_false && false_literal_for(a, f)) { *this = *f; return; }
+		}
 
-		vector<pair<pair<vector<variant<literal,conditional_effect>>, vector<literal> >, additional_variables> > cur = 
-			this->subformulae[0]->expand(compileConditionalEffects);
-		for(pair<string,string> var : this->qvariables.vars){
-			vector<pair<pair<vector<variant<literal,conditional_effect>>, vector<literal> >, additional_variables> > prev = cur;
-			cur.clear();
-			string newName = var.first + "_" + to_string(++global_exists_variable_counter);
+		// absorption: A and (A or B) is A, A or (A and B) is A
+		formula_type dual = this->type == AND ? OR : AND;
+		vector<general_formula*> absorbed;
+		for (auto k : kept){
+			bool absorb = false;
+			if (k->type == dual)
+				for (auto sub : k->subformulae) for (auto other : kept)
+					if (other != k && same_formula(sub, other)) absorb = true;
+			if (!absorb) absorbed.push_back(k);
+		}
+		kept = absorbed;
+	}
 
-			
-			for(auto old : prev){
-				pair<pair<vector<variant<literal,conditional_effect>>,vector<literal> >,  additional_variables>	combined = old;
-				combined.second.insert(make_pair(var_replace[var.first],var.second));
-				cur.push_back(combined);
-			}
+	if (kept.size() == 0 && first_false) { *this = *first_false; return; }
+	if (kept.size() == 0) { this->type = EMPTY; this->subformulae.clear(); return; }
+	if (kept.size() == 1) { *this = *kept[0]; return; }
+	this->subformulae = kept;
+}
+
+int global_exists_variable_counter = 0;
+
+size_t max_expansion_branches = 0;
+
+bool keep_forall_lifted = false;
+
+// the literals of a conjunction. Returns false if the formula is not a conjunction of literals
+bool conjunction_literals(general_formula* f, vector<literal> & literals, additional_variables & constants){
+	if (f->type == EMPTY) return true;
+	if (f->type == AND){
+		for (general_formula* sub : f->subformulae)
+			if (!conjunction_literals(sub, literals, constants)) return false;
+		return true;
+	}
+	if (f->type != ATOM && f->type != NOTATOM) return false;
+	literals.push_back(f->atomLiteral());
+	constants.insert(f->arguments().newVar.begin(), f->arguments().newVar.end());
+	return true;
+}
+
+// the conjuncts of an effect: literals are made true unconditionally, conditional effects get their own quantified literals
+bool effect_literals(general_formula* f, bool compileConditionalEffects, quantified_literals & unconditional, vector<quantified_literals> & conditional, additional_variables & constants){
+	if (f->type == AND){
+		for (general_formula* sub : f->subformulae)
+			if (!effect_literals(sub, compileConditionalEffects, unconditional, conditional, constants)) return false;
+		return true;
+	}
+	if (f->type != WHEN) return conjunction_literals(f, unconditional.literals, constants);
+	// compiled conditional effects are expanded
+	if (compileConditionalEffects) return false;
+	quantified_literals q;
+	q.vars = unconditional.vars;
+	if (!conjunction_literals(f->subformulae[0], q.condition, constants)) return false;
+	if (!conjunction_literals(f->subformulae[1], q.literals, constants)) return false;
+	if (q.literals.size()) conditional.push_back(q);
+	return true;
+}
+
+// a forall whose body is a conjunction of literals (or of conditional effects with such conditions) is kept lifted. Directly nested quantifiers are merged
+bool lift_forall(general_formula* f, bool effect, bool compileConditionalEffects, vector<quantified_literals> & lifted, additional_variables & constants){
+	quantified_literals q;
+	map<string,string> rename;
+	while (f->type == FORALL){
+		// the quantified variables are renamed s.t. they cannot clash with those of the task
+		for (auto & [v,s] : f->qvariables().vars){
+			rename[v] = v + "_forall_" + to_string(lifted.size());
+			q.vars.push_back(make_pair(rename[v], s));
 		}
-		return cur;
+		f = f->subformulae[0];
 	}
+	f = f->copyReplace(rename);
+
+	additional_variables cs;
+	vector<quantified_literals> qs;
+	if (effect){
+		if (!effect_literals(f, compileConditionalEffects, q, qs, cs)) return false;
+	} else if (!conjunction_literals(f, q.literals, cs)) return false;
+	if (q.literals.size()) lifted.push_back(q);
+	lifted.insert(lifted.end(), qs.begin(), qs.end());
+	constants.insert(cs.begin(), cs.end());
+	return true;
+}
 
+general_formula* lift_foralls(general_formula* f, bool effect, bool compileConditionalEffects, vector<quantified_literals> & lifted, additional_variables & constants){
+	if (f->type == FORALL && lift_forall(f, effect, compileConditionalEffects, lifted, constants)){
+		general_formula* empty = new general_formula();
+		empty->type = EMPTY;
+		return empty;
+	}
+	if (f->type != AND) return f;
+
+	bool changed = false;
+	vector<general_formula*> rest;
+	for (general_formula* sub : f->subformulae){
+		general_formula* r = lift_foralls(sub, effect, compileConditionalEffects, lifted, constants);
+		changed |= r != sub;
+		if (r->type != EMPTY) rest.push_back(r);
+	}
+	if (!changed) return f;
 
+	general_formula* ret = new general_formula();
+	ret->type = AND;
+	ret->subformulae = rest;
+	return ret;
+}
 
-	vector<vector<pair<pair<vector<variant<literal,conditional_effect>>, vector<literal> >, additional_variables> > > subresults;
-	for(auto sub : this->subformulae) subresults.push_back(sub->expand(compileConditionalEffects));	
-	
-	// just add all disjuncts to set of literals
-	if (this->type == OR) for(auto subres : subresults) for (auto res: subres) ret.push_back(res);
-
-	//
-	if (this->type == AND){
-		vector<pair<pair<vector<variant<literal,conditional_effect>>,vector<literal> >, additional_variables> > cur = subresults[0];
-		for(unsigned int i = 1; i < subresults.size(); i++){
-			vector<pair<pair<vector<variant<literal,conditional_effect>>, vector<literal> >, additional_variables> > prev = cur;
-			cur.clear();
-			for(auto next : subresults[i]) for(auto old : prev){
-				pair<pair<vector<variant<literal,conditional_effect>>, vector<literal> >, additional_variables> combined = old;
-				for(variant<literal,conditional_effect> l : next.first.first) combined.first.first.push_back(l);
-				for(literal l : next.first.second) combined.first.second.push_back(l);
-				for(auto v : next.second) combined.second.insert(v);
-				cur.push_back(combined);
-			}
+bool auxiliary_disjunctions = false;
+
+general_formula* auxiliary_disjunction_atoms(general_formula* f, const string & name, map<string,string> & var_sorts, vector<auxiliary_disjunction> & aux){
+	if (f->type == OR){
+		auxiliary_disjunction d;
+		d.predicate.name = "__or_" + to_string(aux.size()) + "_" + name;
+		// variables for constants are not arguments of the predicate, the achievers get them from their precondition
+		for (const string & v : f->occuringUnQuantifiedVariables()){
+			auto it = var_sorts.find(v);
+			if (it == var_sorts.end()) continue;
+			d.vars.push_back(*it);
+			d.predicate.argument_sorts.push_back(it->second);
 		}
-		ret = cur;
+		d.disjuncts = f->subformulae;
+
+		general_formula* atom = new general_formula();
+		atom->type = ATOM;
+		atom->predicate = d.predicate.name;
+		for (auto & [v,_] : d.vars) atom->mutable_arguments().vars.push_back(v);
+		aux.push_back(d);
+		return atom;
 	}
+	if (f->type != AND && f->type != EXISTS) return f;
+
+	// existentially quantified variables are arguments of the auxiliary predicates inside the quantifier
+	map<string,string> outer = var_sorts;
+	if (f->type == EXISTS)
+		for (auto & [v,s] : f->qvariables().vars) var_sorts[v] = s;
+
+	bool changed = false;
+	vector<general_formula*> subs;
+	for (general_formula* sub : f->subformulae){
+		subs.push_back(auxiliary_disjunction_atoms(sub, name, var_sorts, aux));
+		changed |= subs.back() != sub;
+	}
+	var_sorts = outer;
+	if (!changed) return f;
+
+	general_formula* ret = new general_formula();
+	ret->type = f->type;
+	if (f->type == FORALL || f->type == EXISTS) ret->mutable_qvariables() = f->qvariables();
+	ret->subformulae = subs;
+	return ret;
+}
 
+general_formula* introduce_auxiliary_disjunctions(general_formula* f, const string & name, const vector<pair<string,string>> & vars, vector<auxiliary_disjunction> & aux){
+	map<string,string> var_sorts(vars.begin(), vars.end());
+	return auxiliary_disjunction_atoms(f, name, var_sorts, aux);
+}
+
+size_t saturating_add(size_t a, size_t b){
+	return a > SIZE_MAX - b ? SIZE_MAX : a + b;
+}
 
-	if (this->type == ATOM || this->type == NOTATOM || this->type == COST) {
-		vector<variant<literal,conditional_effect>> ls;
-		literal l = this->atomLiteral();
-		ls.push_back(l);
+size_t saturating_multiply(size_t a, size_t b){
+	if (a == 0 || b == 0) return 0;
+	return a > SIZE_MAX / b ? SIZE_MAX : a * b;
+}
 
-		additional_variables vars = this->arguments.newVar;
-		vector<literal> empty;
-		ret.push_back(make_pair(make_pair(ls,empty),vars));	
+size_t expansion_node::size() const{
+	if (type == BRANCHES) return branches.size();
+	if (type == ALTERNATIVES){
+		size_t s = 0;
+		for (const expansion_node & c : children) s = saturating_add(s, c.size());
+		return s;
 	}
+	if (type == PRODUCT){
+		size_t s = 1;
+		for (const expansion_node & c : children) s = saturating_multiply(s, c.size());
+		return s;
+	}
+	// CONDITIONAL
+	size_t s = saturating_multiply(children[0].size(), children[1].size());
+	if (compileConditionalEffects) s = saturating_add(s, children[2].size());
+	return s;
+}
 
-	if (this->type == VALUE){
-		vector<variant<literal,conditional_effect>> ls;
-		literal l;
-		l.positive = this->type == ATOM;
-		l.isConstantCostExpression = true;
-		l.costValue = this->value;
-		ls.push_back(l);
+void expansion_node::reset(){
+	position = 0;
+	current.clear();
+	for (expansion_node & c : children) c.reset();
+}
 
-		additional_variables vars;
-		vector<literal> empty;
-		ret.push_back(make_pair(make_pair(ls,empty),vars));	
+bool expansion_node::next(formula_branch & branch){
+	if (type == BRANCHES){
+		if (position == branches.size()) return false;
+		branch = branches[position++];
+		return true;
 	}
-	
-	if (this->type == COST_CHANGE){
-		assert(subresults.size() == 2);
-		assert(subresults[0].size() == 1);
-		assert(subresults[0][0].first.first.size() == 1);
-		assert(holds_alternative<literal>(subresults[0][0].first.first[0]));
-		assert(get<literal>(subresults[0][0].first.first[0]).predicate == metric_target);
-		assert(get<literal>(subresults[0][0].first.first[0]).arguments.size() == 0);
 
-		assert(subresults[1].size() == 1);
-		assert(subresults[1][0].first.first.size() == 1);
-		get<literal>(subresults[1][0].first.first[0]).isCostChangeExpression = true;
-		ret.push_back(subresults[1][0]);
+	if (type == ALTERNATIVES){
+		for (; position < children.size(); position++)
+			if (children[position].next(branch)) return true;
+		return false;
 	}
 
-	// add dummy literal for equal and not equal constraints
-	if (this->type == EQUAL || this->type == NOTEQUAL || this->type == OFSORT || this->type == NOTOFSORT){
-		vector<variant<literal,conditional_effect>> ls;
-		literal l = this->equalsLiteral();
-		ls.push_back(l);
+	if (type == PRODUCT){
+		// position 0: not started, 1: running, 2: done
+		if (position == 2) return false;
+		if (position == 0){
+			position = 1;
+			current.resize(children.size());
+			for (size_t i = 0; i < children.size(); i++)
+				if (!children[i].next(current[i])) { position = 2; return false; }
+		} else {
+			// like an odometer, the first child changes fastest
+			size_t i = 0;
+			for (; i < children.size() && !children[i].next(current[i]); i++){
+				children[i].reset();
+				children[i].next(current[i]);
+			}
+			if (i == children.size()) { position = 2; return false; }
+		}
 
-		additional_variables vars; // no new vars. Never
-		vector<literal> empty;
-		ret.push_back(make_pair(make_pair(ls,empty),vars));	
-		
+		branch = formula_branch();
+		for (formula_branch & part : current){
+			for(variant<literal,conditional_effect> l : part.first.first) branch.first.first.push_back(l);
+			for(literal l : part.first.second) branch.first.second.push_back(l);
+			for(auto v : part.second) branch.second.insert(v);
+		}
+		branch.second.insert(vars.begin(), vars.end());
+		return true;
 	}
 
-	if (this->type == WHEN) {
-		// condition might be a disjunction ..
-		// effect might have multiple expansions (i.e. be disjunctive) we here assume that this means angelic non-determinism
-		for (auto expanded_condition : subresults[0]) for (auto expanded_effect : subresults[1]){
+	// CONDITIONAL. position 0: not started, 1: combining condition (in current) and effect, 2: negated conditions, 3: done
+	if (position == 0){
+		position = 1;
+		current.resize(1);
+		if (!children[0].next(current[0])) position = 2;
+	}
+	while (position == 1){
+		formula_branch expanded_effect;
+		if (children[1].next(expanded_effect)){
+			formula_branch & expanded_condition = current[0];
 			vector<variant<literal,conditional_effect>> eff = expanded_effect.first.first;
 			vector<literal> cond = expanded_effect.first.second;
 			
@@ -318,7 +705,7 @@ vector<pair<pair<vector<variant<literal,conditional_effect>>,vector<literal> >,
 			avs.insert(expanded_condition.second.begin(), expanded_condition.second.end());
 
 			if (compileConditionalEffects)
-				ret.push_back(make_pair(make_pair(eff,cond),avs));
+				branch = make_pair(make_pair(eff,cond),avs);
 			else {
 				// we have to build the conditional effects
 				vector<variant<literal,conditional_effect>> newEff;
@@ -335,26 +722,153 @@ vector<pair<pair<vector<variant<literal,conditional_effect>>,vector<literal> >,
 					}
 				}
 				vector<literal> empty;
-				ret.push_back(make_pair(make_pair(newEff,empty),avs));
+				branch = make_pair(make_pair(newEff,empty),avs);
 			}
+			return true;
 		}
-			
-			
+		children[1].reset();
+		if (!children[0].next(current[0])) position = 2;
+	}
+	if (position == 2 && compileConditionalEffects && children[2].next(branch)){
+		// the action is not applied if the condition does not hold
+		branch.first.second.clear();
+		for (variant<literal,conditional_effect> x : branch.first.first)
+			if (holds_alternative<literal>(x)){
+				branch.first.second.push_back(get<literal>(x));
+			} else assert(false); // conditional effect inside condition
+		branch.first.first.clear();
+		return true;
+	}
+	position = 3;
+	return false;
+}
+
+formula_branch single_literal_branch(literal l, additional_variables vars){
+	vector<variant<literal,conditional_effect>> ls;
+	ls.push_back(l);
+	vector<literal> empty;
+	return make_pair(make_pair(ls,empty),vars);
+}
+
+// hard expansion of formulae. This can grow up to exponentially, but is currently the only thing we can do about disjunctions.
+// this will also handle forall and exists quantors by expansion
+// sorts must have been parsed and expanded prior to this call
+void build_expansion(expansion_node & n, general_formula* f, bool compileConditionalEffects){
+	n.type = expansion_node::BRANCHES;
+	n.compileConditionalEffects = compileConditionalEffects;
+
+	auto pre = precomputed_expansions.find(make_pair(f, compileConditionalEffects));
+	if (pre != precomputed_expansions.end() && !pre->second.taken.exchange(true)){
+		n.branches = move(pre->second.branches);
+		return;
+	}
+
+	if (f->type == EMPTY || (f->subformulae.size() == 0 &&
+				(f->type == AND || f->type == OR || f->type == FORALL || f->type == EXISTS))){
+		n.branches.push_back(formula_branch());
+		return;
+	}
+
+	// generate a big conjunction for forall and expand it
+	if (f->type == FORALL){
+		n.type = expansion_node::PRODUCT;
+		auto [var_replace,avs] = f->forallVariableReplacement();
+		n.children.resize(var_replace.size());
+		for (size_t i = 0; i < var_replace.size(); i++)
+			build_expansion(n.children[i], f->subformulae[0]->copyReplace(var_replace[i]), compileConditionalEffects);
+		// add variables
+		n.vars = avs;
+
+		// the quantified formula itself has always been expanded as well. It does not contribute any branches, but numbers existential variables
+		expansion_node unused;
+		build_expansion(unused, f->subformulae[0], compileConditionalEffects);
+		return;
+	}
+
+
+	// add additional variables for every quantified variable. We have to do this for every possible instance of the precondition below	
+	if (f->type == EXISTS){
+		map<string,string> var_replace = f->existsVariableReplacement();
+
+		n.type = expansion_node::PRODUCT;
+		n.children.resize(1);
+		build_expansion(n.children[0], f->subformulae[0]->copyReplace(var_replace), compileConditionalEffects);
+		for(pair<string,string> var : f->qvariables().vars){
+			++global_exists_variable_counter;
+			n.vars.insert(make_pair(var_replace[var.first],var.second));
+		}
+		return;
+	}
+
+
+	n.children.resize(f->subformulae.size());
+	for (size_t i = 0; i < f->subformulae.size(); i++)
+		build_expansion(n.children[i], f->subformulae[i], compileConditionalEffects);
+	
+	// just add all disjuncts to set of literals
+	if (f->type == OR) n.type = expansion_node::ALTERNATIVES;
+
+	if (f->type == AND) n.type = expansion_node::PRODUCT;
+
+
+	if (f->type == ATOM || f->type == NOTATOM || f->type == COST)
+		n.branches.push_back(single_literal_branch(f->atomLiteral(), f->arguments().newVar));
+
+	if (f->type == VALUE){
+		literal l;
+		l.positive = f->type == ATOM;
+		l.isConstantCostExpression = true;
+		l.costValue = f->value;
+		n.branches.push_back(single_literal_branch(l, additional_variables()));
+	}
+	
+	if (f->type == COST_CHANGE){
+		vector<vector<formula_branch> > subresults(2);
+		for (int i = 0; i < 2; i++){
+			formula_branch b;
+			while (n.children[i].next(b)) subresults[i].push_back(b);
+		}
+		n.children.clear();
+
+		assert(subresults[0].size() == 1);
+		assert(subresults[0][0].first.first.size() == 1);
+		assert(holds_alternative<literal>(subresults[0][0].first.first[0]));
+		assert(get<literal>(subresults[0][0].first.first[0]).predicate == metric_target);
+		assert(get<literal>(subresults[0][0].first.first[0]).arguments.size() == 0);
+
+		assert(subresults[1].size() == 1);
+		assert(subresults[1][0].first.first.size() == 1);
+		get<literal>(subresults[1][0].first.first[0]).isCostChangeExpression = true;
+		n.branches.push_back(subresults[1][0]);
+	}
+
+	// add dummy literal for equal and not equal constraints. No new vars. Never
+	if (f->type == EQUAL || f->type == NOTEQUAL || f->type == OFSORT || f->type == NOTOFSORT)
+		n.branches.push_back(single_literal_branch(f->equalsLiteral(), additional_variables()));
+
+	if (f->type == WHEN) {
+		// condition might be a disjunction ..
+		// effect might have multiple expansions (i.e. be disjunctive) we here assume that this means angelic non-determinism
+		n.type = expansion_node::CONDITIONAL;
 		if (compileConditionalEffects){
 			// remove conditional effects by compiling them into multiple actions ...
-			general_formula cond = *(this->subformulae[0]);
-			cond.negate();
-			for (auto expanded_condition : cond.expand(false)){ // condition cannot contain conditional effect!
-				expanded_condition.first.second.clear();
-				for (variant<literal,conditional_effect> x : expanded_condition.first.first)
-					if (holds_alternative<literal>(x)){
-						expanded_condition.first.second.push_back(get<literal>(x));
-					} else assert(false); // conditional effect inside condition
-				expanded_condition.first.first.clear();
-				ret.push_back(expanded_condition);
-			}
+			// the condition may be shared with other formulae, so a negated copy is expanded
+			n.children.emplace_back();
+			build_expansion(n.children.back(), f->subformulae[0]->negatedCopy(), false); // condition cannot contain conditional effect!
 		}
 	}
+}
+
+formula_expansion::formula_expansion(general_formula* f, bool compileConditionalEffects){
+	build_expansion(root, f, compileConditionalEffects);
+	branches = root.size();
+}
+
+vector<pair<pair<vector<variant<literal,conditional_effect>>,vector<literal> >, additional_variables> > general_formula::expand(bool compileConditionalEffects){
+	vector<pair<pair<vector<variant<literal,conditional_effect>>,vector<literal> >, additional_variables> > ret;
+	formula_expansion expansion(this, compileConditionalEffects);
+	formula_branch branch;
+	while (expansion.next(branch)) ret.push_back(branch);
 	return ret;
 }
 
@@ -368,8 +882,8 @@ literal general_formula::equalsLiteral(){
 		l.predicate = dummy_equal_literal;
 	else
 		l.predicate = dummy_ofsort_literal; 
-	l.arguments.push_back(this->arg1);
-	l.arguments.push_back(this->arg2);
+	l.arguments.push_back(this->arg1());
+	l.arguments.push_back(this->arg2());
 	return l;
 }
 
@@ -382,7 +896,7 @@ literal general_formula::atomLiteral(){
 	l.isConstantCostExpression = false;
 	l.isCostChangeExpression = false;
 	l.predicate = this->predicate;
-	l.arguments = this->arguments.vars;
+	l.arguments = this->arguments().vars;
 
 	return l;
 }
@@ -397,12 +911,13 @@ pair<vector<map<string,string> >, additional_variables> general_formula::forallV
 	map<string,string> empty;
 	var_replace.push_back(empty);
 	int counter = 0;
-	for(pair<string,string> var : this->qvariables.vars) {
+	lock_guard<mutex> lock(sorts_for_constants_mutex);
+	for(pair<string,string> var : this->qvariables().vars) {
 		vector<map<string,string> > old_var_replace = var_replace;
 		var_replace.clear();
 
 		for(string c : sorts[var.second]){
-			string newSort = sort_for_const(c);
+			string newSort = sort_for_const_unlocked(c);
 			string newVar = var.first + "_" + to_string(counter); counter++;
 			avs.insert(make_pair(newVar,newSort));
 			for (map<string,string> old : old_var_replace){
@@ -417,7 +932,7 @@ pair<vector<map<string,string> >, additional_variables> general_formula::forallV
 
 map<string,string> general_formula::existsVariableReplacement(){
 	map<string,string> var_replace;
-	for(pair<string,string> var : this->qvariables.vars){
+	for(pair<string,string> var : this->qvariables().vars){
 		string newName = var.first + "_" + to_string(++global_exists_variable_counter);
 		var_replace[var.first] = newName;
 	}
@@ -464,6 +979,74 @@ void compile_goal_into_action(){
 	goal_formula = NULL;
 }
 
+// whether expanding the formula neither depends on nor changes anything outside of it. Quantifiers need the objects of the problem (and exists uses a global counter),
+// and cost changes are checked against the metric
+bool independent_of_problem(general_formula* f, bool compileConditionalEffects){
+	if (f->type == FORALL || f->type == EXISTS || f->type == COST_CHANGE) return false;
+	for (general_formula* sub : f->subformulae)
+		if (!independent_of_problem(sub, compileConditionalEffects)) return false;
+	return true;
+}
+
+bool expansion_needs_order(general_formula* f, bool compileConditionalEffects){
+	if (f->type == EXISTS) return true;
+	// the negated condition of a compiled conditional effect turns universal quantifiers into existential ones
+	if (f->type == WHEN && compileConditionalEffects && f->subformulae[0]->hasForall()) return true;
+	for (general_formula* sub : f->subformulae)
+		if (expansion_needs_order(sub, compileConditionalEffects)) return true;
+	return false;
+}
+
+void precompute_expansion(general_formula* f, bool compileConditionalEffects){
+	if (!independent_of_problem(f, compileConditionalEffects)) return;
+	auto key = make_pair(f, compileConditionalEffects);
+	if (precomputed_expansions.count(key)) return;
+	vector<formula_branch> branches = f->expand(compileConditionalEffects);
+	precomputed_expansions[key].branches = move(branches);
+}
+
+void precompute_variables(general_formula* f){
+	if (!independent_of_problem(f, false) || precomputed_variables.count(f)) return;
+	precomputed_variables[f] = f->occuringUnQuantifiedVariables();
+}
+
+void simplify_domain_formulae(vector<parsed_task> & primitives, map<string,vector<parsed_method> > & methods){
+	for (parsed_task & a : primitives){
+		a.prec->simplify(false);
+		a.eff->simplify(true);
+	}
+	for (auto & [_, mm] : methods)
+		for (parsed_method & m : mm){
+			m.prec->simplify(false);
+			m.eff->simplify(true);
+			m.tn->constraint->simplify(false);
+		}
+}
+
+void precompute_domain_lowering(vector<parsed_task> & primitives, map<string,vector<parsed_method> > & methods,
+		bool compileConditionalEffects, bool encodeDisjunctivePreconditionsInMethods, bool methodPreconditions){
+	// disjunctive preconditions encoded as methods or with auxiliary predicates are not expanded as a whole
+	auto precompute_precondition = [&](general_formula* prec){
+		if ((!encodeDisjunctivePreconditionsInMethods && !auxiliary_disjunctions) || !prec->isDisjunctive()) precompute_expansion(prec, false);
+	};
+
+	for (parsed_task & a : primitives){
+		precompute_precondition(a.prec);
+		precompute_expansion(a.eff, compileConditionalEffects);
+	}
+
+	for (auto & [_, mm] : methods)
+		for (parsed_method & m : mm){
+			if (methodPreconditions){
+				precompute_precondition(m.prec);
+				precompute_variables(m.prec);
+			}
+			precompute_expansion(m.eff, compileConditionalEffects);
+			precompute_variables(m.eff);
+			precompute_expansion(m.tn->constraint, false);
+		}
+}
+
 void remove_method_preconditions(){
 	for (auto & [_, mm] : parsed_methods){
 		for (auto & m : mm){
@@ -473,3 +1056,42 @@ void remove_method_preconditions(){
 	}
 
 }
+
+
+void release_parse_tree(){
+	// tasks and methods may share parts of their parse trees, so collect everything before deleting it
+	set<var_declaration*> declarations;
+	set<parsed_task_network*> networks;
+	set<sub_task*> subtasks;
+	set<var_and_const*> arguments;
+	set<pair<string,string>*> orderings;
+
+	for (parsed_task & t : parsed_primitive) declarations.insert(t.arguments);
+	for (parsed_task & t : parsed_abstract) declarations.insert(t.arguments);
+	for (auto & [_, mm] : parsed_methods)
+		for (parsed_method & m : mm){
+			declarations.insert(m.vars);
+			networks.insert(m.tn);
+			for (sub_task* st : m.tn->tasks){
+				subtasks.insert(st);
+				arguments.insert(st->arguments);
+			}
+			orderings.insert(m.tn->ordering.begin(), m.tn->ordering.end());
+		}
+
+	vector<parsed_task>().swap(parsed_primitive);
+	vector<parsed_task>().swap(parsed_abstract);
+	parsed_methods.clear();
+	goal_formula = NULL;
+
+	for (var_declaration* d : declarations) delete d;
+	for (parsed_task_network* tn : networks) delete tn;
+	for (sub_task* st : subtasks) delete st;
+	for (var_and_const* a : arguments) delete a;
+	for (pair<string,string>* o : orderings) delete o;
+
+	precomputed_expansions.clear();
+	precomputed_variables.clear();
+	interned_formulae.clear();
+	release_formula_arena();
+}
@@ -9,8 +9,6 @@
 #include "domain.hpp"
 using namespace std;
 
-extern int task_id_counter;
-
 struct sort_definition{
 	vector<string> declared_sorts;
 	bool has_parent_sort;
@@ -32,13 +30,6 @@ struct var_and_const{
 	additional_variables newVar; // varname & sort
 };
 
-struct function_expression{
-	bool isOnlyValue;
-	int value;
-	string name;
-	var_and_const arguments;
-};
-
 enum formula_type {EMPTY, AND, OR, FORALL, EXISTS, ATOM, NOTATOM,  // formulae
 				   EQUAL, NOTEQUAL, OFSORT, NOTOFSORT,
 				   WHEN,   // conditional effect
@@ -50,15 +41,27 @@ class general_formula{
 		formula_type type;
 		vector<general_formula*> subformulae;
 		string predicate;
-		var_and_const arguments;
-		var_declaration qvariables;
-		function_expression *value_increased, *increase_amount;
-
-		string arg1;
-		string arg2;
 		int value;
 
+		// the fields only some kinds of formulae have. Formulae of other kinds return empty ones
+		// ATOM, NOTATOM, COST
+		const var_and_const & arguments() const;
+		// FORALL, EXISTS
+		const var_declaration & qvariables() const;
+		// EQUAL, NOTEQUAL, OFSORT, NOTOFSORT
+		const string & arg1() const;
+		const string & arg2() const;
+		// write access, the fields of the kind replace those of any other kind
+		var_and_const & mutable_arguments();
+		var_declaration & mutable_qvariables();
+		pair<string,string> & mutable_args();
+		bool same_fields(const general_formula & other) const;
+		// which of the fields are stored: 0 none, 1 arguments, 2 qvariables, 3 arg1 and arg2
+		size_t fields_kind() const;
+
 		void negate();
+		// a negated copy, the formula itself is not changed
+		general_formula* negatedCopy();
 		bool isEmpty();
 		bool hasEquals();
 		bool hasExists();
@@ -67,6 +70,12 @@ class general_formula{
 		// if it is an uncompiled conditional effect, the additional prec will be empty
 		vector<pair<pair<vector<variant<literal,conditional_effect>>,vector<literal> >, additional_variables> > expand(bool compileConditionalEffects);
 		bool isDisjunctive();
+		// whether the formula is an equality that can never hold, which is used as false
+		bool isFalse();
+		// simplifies the formula in place: nested conjunctions and disjunctions are flattened, duplicates, true, and false are removed,
+		// constant equalities, complementary literals, and absorbed sub-formulae are folded. Effects are only flattened, conditional effects with a false
+		// condition are removed. Complementary literals are only folded into false where it reaches the top of the precondition, i.e. not below a quantifier
+		void simplify(bool effect, bool fold_false = true);
 		additional_variables variables_for_constants();
 		
 		literal equalsLiteral();
@@ -76,8 +85,78 @@ class general_formula{
 
 		set<string> occuringUnQuantifiedVariables();
 
+		// the formula with the variables replaced. Parts that contain none of them are shared with the formula, the others are hash-consed
 		general_formula* copyReplace(map<string,string>& replace);
+
+		// formulae are allocated from an arena and are only freed together by release_parse_tree
+		static void* operator new(size_t size);
+		static void operator delete(void* p);
+	private:
+		// tagged union, a node only stores the fields of its kind
+		variant<monostate, var_and_const, var_declaration, pair<string,string>> fields;
+};
+
+
+// one conjunctive branch of an expanded formula. first: effect, second: additional precondition for that effect
+typedef pair<pair<vector<variant<literal,conditional_effect>>,vector<literal> >, additional_variables> formula_branch;
+
+// the structure of a formula as far as its expansion is concerned. Quantifiers are instantiated and literals are copied, i.e. the node does not refer to the formula any more
+struct expansion_node{
+	enum node_type {BRANCHES, ALTERNATIVES, PRODUCT, CONDITIONAL} type;
+	// BRANCHES: the branches are given explicitly
+	vector<formula_branch> branches;
+	// ALTERNATIVES: the branches of all children one after another, PRODUCT: all combinations of the branches of the children
+	// CONDITIONAL: condition and effect, and the negated condition if conditional effects are compiled
+	vector<expansion_node> children;
+	// added to every branch, for quantified variables
+	additional_variables vars;
+	bool compileConditionalEffects = false;
+
+	// state of the enumeration
+	size_t position = 0;
+	vector<formula_branch> current;
+
+	size_t size() const;
+	bool next(formula_branch & branch);
+	void reset();
+};
+
+// lazy form of general_formula::expand, the branches are generated one at a time and in the same order as expand returns them.
+// Constructing the expansion has the same side effects on the formula as expand
+class formula_expansion{
+	public:
+		formula_expansion(general_formula* f, bool compileConditionalEffects);
+		// number of branches, saturated at SIZE_MAX
+		size_t size() const { return branches; }
+		// the next branch. Returns false once all branches have been generated
+		bool next(formula_branch & branch) { return root.next(branch); }
+		// starts again with the first branch
+		void reset() { root.reset(); }
+	private:
+		expansion_node root;
+		size_t branches;
+};
+
+// the number of branches an action may be expanded into at most, 0 means no limit
+extern size_t max_expansion_branches;
+
+// whether universally quantified conjunctions of literals are kept lifted instead of being expanded
+extern bool keep_forall_lifted;
+// takes the universally quantified parts of the conjunction f that can be kept lifted out of it and returns the rest of the formula. f itself is not changed.
+// The constants used in the lifted parts are replaced by variables, which are added to constants
+general_formula* lift_foralls(general_formula* f, bool effect, bool compileConditionalEffects, vector<quantified_literals> & lifted, additional_variables & constants);
+
+// whether disjunctions in preconditions are replaced by auxiliary predicates, which are made true by one achiever action per disjunct
+extern bool auxiliary_disjunctions;
+// a disjunction of a precondition that is replaced by an auxiliary predicate over its free variables
+struct auxiliary_disjunction{
+	predicate_definition predicate;
+	vector<pair<string,string>> vars;
+	vector<general_formula*> disjuncts;
 };
+// replaces the disjunctions of the precondition f of the task name that are not universally quantified by atoms of new auxiliary predicates, which are added to aux.
+// f itself is not changed. The variables are those of the task
+general_formula* introduce_auxiliary_disjunctions(general_formula* f, const string & name, const vector<pair<string,string>> & vars, vector<auxiliary_disjunction> & aux);
 
 
 struct parsed_task{
@@ -122,7 +201,18 @@ extern string metric_target;
 
 
 string sort_for_const(string c);
+size_t hash_combine(size_t h, size_t v);
 void compile_goal_into_action();
 void remove_method_preconditions();
+// simplifies all formulae of the domain, must be done before they are expanded
+void simplify_domain_formulae(vector<parsed_task> & primitives, map<string,vector<parsed_method> > & methods);
+// expands the formulae of the domain that do not depend on the problem (no quantifiers, no cost changes) in advance, s.t. this can be done while the problem is still being parsed.
+// The flags have to be the ones later used for lowering. Each precomputed expansion is used by the first call of expand on its formula
+void precompute_domain_lowering(vector<parsed_task> & primitives, map<string,vector<parsed_method> > & methods,
+		bool compileConditionalEffects, bool encodeDisjunctivePreconditionsInMethods, bool methodPreconditions);
+// whether expanding the formula numbers existential variables with the global counter. Such formulae have to be expanded in the order of the input to get the same names in every run
+bool expansion_needs_order(general_formula* f, bool compileConditionalEffects);
+// frees all parsed tasks, methods, and formulae. Must only be called once they are not needed any more, i.e. after lowering
+void release_parse_tree();
 
 #endif
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#include "passmanager.hpp"
+#include "cwa.hpp"
+#include "domain.hpp"
+#include "inference.hpp"
+#include "parametersplitting.hpp"
+#include "parsetree.hpp"
+#include "tworegularize.hpp"
+#include "util.hpp"
+
+using namespace std;
+
+model_size current_model_size(){
+	model_size size;
+	size.sorts = sorts.size();
+	size.predicates = predicate_definitions.size();
+	size.primitive_tasks = primitive_tasks.size();
+	size.abstract_tasks = abstract_tasks.size();
+	size.methods = methods.size();
+	size.literals = 0;
+	for (const task & t : primitive_tasks){
+		size.literals += t.prec.size() + t.eff.size() + t.constraints.size();
+		for (const conditional_effect & ceff : t.ceff) size.literals += ceff.condition.size() + 1;
+		for (const vector<quantified_literals> * lifted : {&t.forall_prec, &t.forall_eff})
+			for (const quantified_literals & q : *lifted) size.literals += q.condition.size() + q.literals.size();
+	}
+	for (const method & m : methods) size.literals += m.constraints.size();
+	size.init = init.size();
+	return size;
+}
+
+const vector<transformation_pass> & registered_passes(){
+	static const vector<transformation_pass> passes = {
+		{"split-parameters", "split methods with independent parameters to reduce the size of the grounding",
+			PART_SORTS | PART_TASKS | PART_METHODS, PART_TASKS | PART_METHODS, split_independent_parameters},
+		{"two-regularization", "re-formulate totally ordered methods s.t. they have at most two subtasks",
+			PART_TASKS | PART_METHODS, PART_TASKS | PART_METHODS, two_regularize_methods},
+		{"infer-preconditions", "infer preconditions of abstract tasks for faster progression search",
+			PART_PREDICATES | PART_TASKS | PART_METHODS, PART_TASKS | PART_METHODS, infer_preconditions},
+		{"cwa", "add the negative facts of the initial state for the predicates that occur negatively (closed world assumption)",
+			PART_SORTS | PART_PREDICATES | PART_TASKS | PART_INIT | PART_GOAL, PART_SORTS | PART_INIT, compute_cwa},
+		{"reduce-constraints", "propagate variable constraints into the sorts of the variables and remove unsatisfiable tasks and methods",
+			PART_SORTS | PART_TASKS | PART_METHODS, PART_SORTS | PART_TASKS | PART_METHODS, reduce_constraints},
+		{"clean-up-sorts", "merge sorts with the same elements",
+			PART_SORTS | PART_PREDICATES | PART_TASKS | PART_METHODS, PART_SORTS | PART_PREDICATES | PART_TASKS | PART_METHODS, clean_up_sorts},
+		{"remove-unnecessary-predicates", "remove predicates that occur in no precondition or goal",
+			PART_PREDICATES | PART_TASKS | PART_INIT | PART_GOAL, PART_PREDICATES | PART_TASKS | PART_INIT | PART_GOAL, remove_unnecessary_predicates},
+	};
+	return passes;
+}
+
+const transformation_pass * find_pass(const string & name){
+	for (const transformation_pass & p : registered_passes())
+		if (p.name == name) return &p;
+	return nullptr;
+}
+
+bool parse_pipeline(const string & list, vector<const transformation_pass*> & pipeline){
+	stringstream ss(list);
+	string name;
+	while (getline(ss, name, ',')){
+		if (name.empty()) continue;
+		const transformation_pass * p = find_pass(name);
+		if (!p){
+			cout << "Unknown transformation pass " << name << ". Use --list-passes to see all passes." << endl;
+			return false;
+		}
+		pipeline.push_back(p);
+	}
+
+	// cwa adds the negative facts to the initial state (or with implicit_cwa determines the closed world predicates) and only reduce-constraints removes the
+	// sort constraints, which the output cannot represent
+	for (string needed : {"cwa", "reduce-constraints"}){
+		const transformation_pass * p = find_pass(needed);
+		if (find(pipeline.begin(), pipeline.end(), p) != pipeline.end()) continue;
+		cout << "The transformation pass " << needed << " is needed for the output and is appended to the pipeline." << endl;
+		pipeline.push_back(p);
+	}
+	return true;
+}
+
+string model_parts(int parts){
+	vector<pair<model_part,string>> names = {{PART_SORTS,"sorts"}, {PART_PREDICATES,"predicates"}, {PART_TASKS,"tasks"},
+		{PART_METHODS,"methods"}, {PART_INIT,"init"}, {PART_GOAL,"goal"}};
+	string ret;
+	for (auto & [part, name] : names) if (parts & part)
+		ret += (ret.size() ? "," : "") + name;
+	return ret;
+}
+
+void list_passes(ostream & out){
+	for (const transformation_pass & p : registered_passes()){
+		out << color(COLOR_RED, p.name) << ": " << p.description << endl;
+		out << "\treads: " << model_parts(p.reads) << endl;
+		out << "\twrites: " << model_parts(p.writes) << endl;
+	}
+}
+
+// -1 if the peak memory is not known
+long peak_memory_kb(){
+#ifdef _WIN32
+	return -1;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage)) return -1;
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
+
+string size_change(const string & what, long before, long after){
+	string ret = what + " " + to_string(after);
+	if (after != before) ret += " (" + string(after > before ? "+" : "") + to_string(after - before) + ")";
+	return ret;
+}
+
+// a hash of the names and sizes in each part of the model, used to find the parts a pass changed
+map<model_part,size_t> part_fingerprints(){
+	hash<string> hs;
+	auto hash_vars = [&](size_t h, const vector<pair<string,string>> & vars){
+		for (auto & [v,s] : vars) h = hash_combine(hash_combine(h, hs(v)), hs(s));
+		return h;
+	};
+
+	map<model_part,size_t> fp;
+	size_t h = 0;
+	for (auto & [s, elems] : sorts) h = hash_combine(hash_combine(h, hs(s)), elems.size());
+	fp[PART_SORTS] = h;
+
+	h = 0;
+	for (const predicate_definition & p : predicate_definitions) h = hash_combine(hash_combine(h, hs(p.name)), p.argument_sorts.size());
+	fp[PART_PREDICATES] = h;
+
+	h = 0;
+	for (const vector<task> * tasks : {&primitive_tasks, &abstract_tasks})
+		for (const task & t : *tasks){
+			h = hash_vars(hash_combine(h, hs(t.name)), t.vars);
+			h = hash_combine(hash_combine(hash_combine(h, t.prec.size()), t.eff.size()), t.constraints.size());
+			h = hash_combine(hash_combine(hash_combine(h, t.ceff.size()), t.forall_prec.size()), t.forall_eff.size());
+		}
+	fp[PART_TASKS] = h;
+
+	h = 0;
+	for (const method & m : methods){
+		h = hash_vars(hash_combine(hash_combine(h, hs(m.name)), hs(m.at)), m.vars);
+		for (const plan_step & ps : m.ps) h = hash_combine(h, hs(ps.task));
+		h = hash_combine(hash_combine(h, m.constraints.size()), m.ordering.size());
+	}
+	fp[PART_METHODS] = h;
+
+	fp[PART_INIT] = init.size();
+
+	h = 0;
+	for (const ground_literal & l : goal) h = hash_combine(hash_combine(h, hs(l.predicate)), l.positive);
+	fp[PART_GOAL] = h;
+	return fp;
+}
+
+void run_pipeline(const vector<const transformation_pass*> & pipeline, bool stats){
+	for (const transformation_pass * p : pipeline){
+		model_size before{};
+		if (stats) before = current_model_size();
+		// hashing the whole model twice per pass is too expensive for release builds, which only check it if the stats are requested
+		bool check_writes = stats;
+#ifndef NDEBUG
+		check_writes = true;
+#endif
+		map<model_part,size_t> parts_before;
+		if (check_writes) parts_before = part_fingerprints();
+		auto start = chrono::steady_clock::now();
+
+		p->run();
+
+		int undeclared = 0;
+		if (check_writes)
+			for (auto & [part, fp] : part_fingerprints())
+				if (fp != parts_before[part] && !(p->writes & part)) undeclared |= part;
+		if (undeclared){
+			cout << color(COLOR_RED, "Error") << ": the transformation pass " << p->name << " changed " << model_parts(undeclared) << ", which it does not declare to write." << endl;
+			exit(1);
+		}
+
+		if (!stats) continue;
+		stringstream seconds;
+		seconds << fixed << setprecision(3) << chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		model_size after = current_model_size();
+		long peak = peak_memory_kb();
+		cout << "Pass " << color(COLOR_RED, p->name) << ": " << seconds.str() << "s, peak memory " << (peak < 0 ? "unknown" : to_string(peak / 1024) + " MB") << endl;
+		cout << "\t" << size_change("sorts", before.sorts, after.sorts)
+			<< ", " << size_change("predicates", before.predicates, after.predicates)
+			<< ", " << size_change("primitives", before.primitive_tasks, after.primitive_tasks)
+			<< ", " << size_change("abstracts", before.abstract_tasks, after.abstract_tasks)
+			<< ", " << size_change("methods", before.methods, after.methods)
+			<< ", " << size_change("literals", before.literals, after.literals)
+			<< ", " << size_change("init", before.init, after.init) << endl;
+	}
+}
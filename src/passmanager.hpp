@@ -0,0 +1,48 @@
+#ifndef __PASSMANAGER
+#define __PASSMANAGER
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// the parts of the lowered model that a pass reads or changes
+enum model_part{
+	PART_SORTS = 1,
+	PART_PREDICATES = 2,
+	PART_TASKS = 4,
+	PART_METHODS = 8,
+	PART_INIT = 16,
+	PART_GOAL = 32
+};
+
+// a transformation of the lowered model. Passes work on the global model, reads and writes are bitmasks of model_part
+struct transformation_pass{
+	string name;
+	string description;
+	int reads;
+	int writes;
+	function<void()> run;
+};
+
+// the size of the lowered model, used to report how a pass changed it
+struct model_size{
+	long sorts, predicates, primitive_tasks, abstract_tasks, methods, literals, init;
+};
+
+model_size current_model_size();
+
+// all passes that can be used in a pipeline, in the order of the default pipeline
+const vector<transformation_pass> & registered_passes();
+const transformation_pass * find_pass(const string & name);
+// reads a comma separated list of pass names. Returns false if one of them is unknown. The output needs the closed world assumption applied and the sort
+// constraints reduced, so cwa and reduce-constraints are appended if the list does not contain them
+bool parse_pipeline(const string & list, vector<const transformation_pass*> & pipeline);
+void list_passes(ostream & out);
+// runs the passes in order. In debug builds and with stats, a pass that changes a part of the model it does not declare to write is an error. With stats, the
+// wall time, peak memory, and changes in the model size are reported after each pass
+void run_pipeline(const vector<const transformation_pass*> & pipeline, bool stats);
+
+#endif
@@ -231,7 +231,7 @@ void write_instance_as_SHOP(ostream & dout, ostream & pout){
 	pout << "(defproblem problem domain " << endl;
 	pout << "  (" << endl;
 	// initial state
-	for (ground_literal & gl : init){
+	for (ground_literal & gl : init.literals()){
 		if (!gl.positive) continue;
 		pout << "    (" << sanitise(gl.predicate);
 		for (string & arg : gl.args)
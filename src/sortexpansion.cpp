@@ -7,22 +7,147 @@
 
 using namespace std;
 
+bool bitset_contains(const id_bitset & b, int i){
+	size_t w = i / 64;
+	return w < b.size() && (b[w] >> (i % 64)) & 1;
+}
+
+void bitset_insert(id_bitset & b, int i){
+	size_t w = i / 64;
+	if (w >= b.size()) b.resize(w + 1, 0);
+	b[w] |= uint64_t(1) << (i % 64);
+}
+
+void bitset_trim(id_bitset & b){
+	while (b.size() && !b.back()) b.pop_back();
+}
+
+void bitset_erase(id_bitset & b, int i){
+	size_t w = i / 64;
+	if (w >= b.size()) return;
+	b[w] &= ~(uint64_t(1) << (i % 64));
+	bitset_trim(b);
+}
+
+void bitset_union(id_bitset & b, const id_bitset & other){
+	if (other.size() > b.size()) b.resize(other.size(), 0);
+	for (size_t w = 0; w < other.size(); w++) b[w] |= other[w];
+}
+
+void bitset_subtract(id_bitset & b, const id_bitset & other){
+	for (size_t w = 0; w < min(b.size(), other.size()); w++) b[w] &= ~other[w];
+	bitset_trim(b);
+}
+
+bool bitset_is_subset(const id_bitset & sub, const id_bitset & super){
+	if (sub.size() > super.size()) return false;
+	for (size_t w = 0; w < sub.size(); w++)
+		if (sub[w] & ~super[w]) return false;
+	return true;
+}
+
+bool bitset_intersects(const id_bitset & a, const id_bitset & b){
+	for (size_t w = 0; w < min(a.size(), b.size()); w++)
+		if (a[w] & b[w]) return true;
+	return false;
+}
+
+size_t bitset_size(const id_bitset & b){
+	size_t size = 0;
+	for (uint64_t w : b) size += __builtin_popcountll(w);
+	return size;
+}
+
+size_t id_bitset_hash::operator()(const id_bitset & b) const{
+	size_t h = b.size();
+	for (uint64_t w : b) h ^= hash<uint64_t>()(w) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+	return h;
+}
+
+int sort_lattice::constant_id(const string & c){
+	auto it = constant_ids.find(c);
+	if (it != constant_ids.end()) return it->second;
+	constant_ids[c] = constants.size();
+	constants.push_back(c);
+	return constants.size() - 1;
+}
+
+const string & sort_lattice::constant_name(int c) const{
+	return constants[c];
+}
+
+int sort_lattice::set_id(const id_bitset & elems){
+	auto it = set_ids.find(elems);
+	if (it != set_ids.end()) return it->second;
+	set_ids[elems] = sets.size();
+	sets.push_back(elems);
+	return sets.size() - 1;
+}
+
+int sort_lattice::set_id(const set<string> & elems){
+	id_bitset b;
+	for (const string & c : elems) bitset_insert(b, constant_id(c));
+	return set_id(b);
+}
+
+int sort_lattice::sort_set(const string & sort){
+	auto it = sort_sets.find(sort);
+	if (it != sort_sets.end()) return it->second;
+	int s = set_id(sorts[sort]);
+	sort_sets[sort] = s;
+	return s;
+}
+
+void sort_lattice::add_sort(const string & sort, int s){
+	sort_sets[sort] = s;
+	sorts[sort] = element_names(s);
+}
+
+const id_bitset & sort_lattice::elements(int s) const{
+	return sets[s];
+}
+
+set<string> sort_lattice::element_names(int s) const{
+	set<string> ret;
+	for (size_t w = 0; w < sets[s].size(); w++)
+		for (uint64_t bits = sets[s][w]; bits; bits &= bits - 1)
+			ret.insert(constants[w * 64 + __builtin_ctzll(bits)]);
+	return ret;
+}
+
+bool sort_lattice::contains(int s, int c) const{
+	return bitset_contains(sets[s], c);
+}
+
+bool sort_lattice::is_subset(int sub, int super) const{
+	return sub == super || bitset_is_subset(sets[sub], sets[super]);
+}
+
+size_t sort_lattice::size(int s) const{
+	return bitset_size(sets[s]);
+}
+
+
 map<string,set<string> > sort_adj;
 
 map<string, int> sort_visi;
 
+// the elements of the sorts while the hierarchy is expanded
+sort_lattice expansion_lattice;
+map<string,id_bitset> sort_elements;
+
 void expansion_dfs(string sort){
 	if (sort_visi[sort] == 1) {
 		cout << "Sort hierarchy contains a cycle ... " << endl;
 		exit(3);
 	}
-	
+
 	sort_visi[sort] = 1;
 
 	for(string subsort : sort_adj[sort]){
-		if (sort_visi[sort] != 2) expansion_dfs(subsort); // if not black
+		if (sort_visi[subsort] != 2) expansion_dfs(subsort); // if not black
 		// add constants to myself
-		for (string subelem : sorts[subsort]) sorts[sort].insert(subelem);
+		bitset_union(sort_elements[sort], sort_elements[subsort]);
 	}
 	sort_visi[sort] = 2;
 }
@@ -35,6 +160,17 @@ void expand_sorts(){
 			if (def.has_parent_sort) sort_adj[def.parent_sort].insert(subsort);
 		}
 	}
-	
-	for(auto s : sorts) expansion_dfs(s.first);
+
+	for (auto & [s, elems] : sorts)
+		for (const string & c : elems) bitset_insert(sort_elements[s], expansion_lattice.constant_id(c));
+
+	sort_visi.clear();
+	for(auto & s : sorts) if (sort_visi[s.first] != 2) expansion_dfs(s.first);
+
+	for (auto & [s, elems] : sorts){
+		for (size_t w = 0; w < sort_elements[s].size(); w++)
+			for (uint64_t bits = sort_elements[s][w]; bits; bits &= bits - 1)
+				elems.insert(expansion_lattice.constant_name(w * 64 + __builtin_ctzll(bits)));
+	}
+	sort_elements.clear();
 }
@@ -1,2 +1,57 @@
+#ifndef __SORTEXPANSION
+#define __SORTEXPANSION
+
+#include <cstdint>
+#include <vector>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+// a set of dense ids with one bit per id. Trailing zero words are removed, s.t. equal sets have equal representations
+typedef vector<uint64_t> id_bitset;
+
+bool bitset_contains(const id_bitset & b, int i);
+void bitset_insert(id_bitset & b, int i);
+void bitset_erase(id_bitset & b, int i);
+void bitset_union(id_bitset & b, const id_bitset & other);
+void bitset_subtract(id_bitset & b, const id_bitset & other);
+bool bitset_is_subset(const id_bitset & sub, const id_bitset & super);
+bool bitset_intersects(const id_bitset & a, const id_bitset & b);
+size_t bitset_size(const id_bitset & b);
+
+struct id_bitset_hash{
+	size_t operator()(const id_bitset & b) const;
+};
+
+// sets of constants as bitsets over dense constant ids. Every set is stored only once (hash-consing), s.t. two sets are equal iff their ids are
+class sort_lattice{
+	public:
+		int constant_id(const string & c);
+		const string & constant_name(int c) const;
+
+		// the id of the set, it is added if it is not known yet
+		int set_id(const id_bitset & elems);
+		int set_id(const set<string> & elems);
+		// the set of the elements of a sort. They must not change afterwards
+		int sort_set(const string & sort);
+		// adds a new sort with the elements of the set
+		void add_sort(const string & sort, int s);
+		const id_bitset & elements(int s) const;
+		set<string> element_names(int s) const;
+
+		bool contains(int s, int c) const;
+		bool is_subset(int sub, int super) const;
+		size_t size(int s) const;
+	private:
+		vector<string> constants;
+		unordered_map<string,int> constant_ids;
+		vector<id_bitset> sets;
+		unordered_map<id_bitset,int,id_bitset_hash> set_ids;
+		unordered_map<string,int> sort_sets;
+};
+
 void expand_sorts();
 
+#endif
@@ -4,23 +4,30 @@
 #include "parsetree.hpp"
 #include <set>
 
-void create_typeof(){
-	// create a sort containing all objects
-	for (auto s : sorts) for (string e : s.second) sorts["__object"].insert(e);
-	
-	// add instances to init
-	for (auto s : sorts) for (string e : s.second){
-		ground_literal l;
-		l.predicate = "typeOf";
-		l.positive = true;
-		l.args.push_back(e);
-		l.args.push_back(s.first);
-		init.push_back(l);
+bool implicit_typeof = false;
+
+// the sorts that typeOf facts are defined for, i.e. those existing when the predicate was created
+set<string> typeof_sorts;
+
+void add_typeof_facts(){
+	for (const string & s : typeof_sorts) {
+		int sort_id = init.constant_id(s);
+		for (const string & e : sorts[s])
+			init.add("typeOf", true, {init.constant_id(e), sort_id});
 	}
+}
+
+void create_typeof(){
+	// create a sort containing all objects. Variables and quantifiers of the domain may use it, so it is needed even if no typeOf facts are
+	set<string> & objects = sorts["__object"];
+	for (auto & s : sorts) if (&s.second != &objects) objects.insert(s.second.begin(), s.second.end());
 	
-	set<string> allSorts;
-	for(auto s : sorts) allSorts.insert(s.first);
-	sorts["Type"] = allSorts;
+	typeof_sorts.clear();
+	for (auto & s : sorts) typeof_sorts.insert(s.first);
+	sorts["Type"] = typeof_sorts;
+
+	// add instances to init, unless they are compiled into constraints after lowering
+	if (!implicit_typeof) add_typeof_facts();
 
 	predicate_definition typePred;
 	typePred.name = "typeOf";
@@ -30,3 +37,52 @@ void create_typeof(){
 
 	
 }
+
+// the sort constraints are removed by the reduce-constraints pass, which every pipeline contains
+void compile_typeof(){
+	// facts that actions change are no sort memberships
+	for (const task & t : primitive_tasks){
+		bool changed = false;
+		for (const literal & l : t.eff) changed |= l.predicate == "typeOf";
+		for (const conditional_effect & ceff : t.ceff) changed |= ceff.effect.predicate == "typeOf";
+		for (const quantified_literals & q : t.forall_eff)
+			for (const literal & l : q.literals) changed |= l.predicate == "typeOf";
+		if (changed) {
+			add_typeof_facts();
+			return;
+		}
+	}
+
+	bool facts_needed = false;
+	for (task & t : primitive_tasks){
+		map<string,string> sort_of(t.vars.begin(), t.vars.end());
+		// a precondition whose sort argument can only be one sort is a sort constraint on the object
+		filter_in_place(t.prec, [&](literal & l){
+			if (l.predicate != "typeOf") return true;
+			auto var = sort_of.find(l.arguments[1]);
+			auto types = var == sort_of.end() ? sorts.end() : sorts.find(var->second);
+			if (types == sorts.end() || types->second.size() != 1 || !typeof_sorts.count(*types->second.begin())){
+				facts_needed = true;
+				return true;
+			}
+			literal c;
+			c.positive = l.positive;
+			c.predicate = dummy_ofsort_literal;
+			c.arguments.push_back(l.arguments[0]);
+			c.arguments.push_back(*types->second.begin());
+			t.constraints.push_back(c);
+			return false;
+		});
+
+		// anything else still needs the facts
+		for (const conditional_effect & ceff : t.ceff)
+			for (const literal & l : ceff.condition) facts_needed |= l.predicate == "typeOf";
+		for (const quantified_literals & q : t.forall_prec)
+			for (const literal & l : q.literals) facts_needed |= l.predicate == "typeOf";
+		for (const quantified_literals & q : t.forall_eff)
+			for (const literal & l : q.condition) facts_needed |= l.predicate == "typeOf";
+	}
+	for (const ground_literal & l : goal) facts_needed |= l.predicate == "typeOf";
+
+	if (facts_needed) add_typeof_facts();
+}
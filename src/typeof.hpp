@@ -1,3 +1,7 @@
 #include "cwa.hpp"
 
+// with implicit typeOf, the facts of the typeOf predicate are only created if compile_typeof cannot replace all its preconditions by sort constraints
+extern bool implicit_typeof;
+
 void create_typeof();
+void compile_typeof();
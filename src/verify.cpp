@@ -36,10 +36,10 @@ string get_const(string varOrConst, map<string,string> & variableAssignment, add
 bool doesFormulaContainVariable(general_formula * f, string variable, int debugMode, int level){
 	if (f->type == EMPTY) return false;
 	if (f->type == EQUAL || f->type == NOTEQUAL) {
-		return (f->arg1 == variable) || (f->arg2 == variable);
+		return (f->arg1() == variable) || (f->arg2() == variable);
 	}
 	if (f->type == OFSORT || f->type == NOTOFSORT) {
-		return f->arg1 == variable;
+		return f->arg1() == variable;
 	}
 
 	if (f->type == AND || f->type == OR){
@@ -49,14 +49,14 @@ bool doesFormulaContainVariable(general_formula * f, string variable, int debugM
 	}
 
 	if (f->type == ATOM || f->type == NOTATOM){
-		for (string v : f->arguments.vars){
+		for (string v : f->arguments().vars){
 			if (v == variable) return true;
 		}
 		return false;
 	}
 
 	if (f->type == FORALL || f->type == EXISTS){
-		for (pair<string,string> qvar : f->qvariables.vars)
+		for (pair<string,string> qvar : f->qvariables().vars)
 			if (qvar.first == variable){
 				print_n_spaces(1+2*level+1);
 				cout << color(COLOR_RED,"Quantifiying over variable that is a method parameter: ") << variable << endl;
@@ -87,7 +87,7 @@ bool doesFormulaContainVariable(general_formula * f, string variable, int debugM
 // FORWARD DECLARATION -- the recursion of the next two function is intertwined
 bool evaluateFormulaOnState(general_formula * f, set<ground_literal> & state, map<string,string> & variable_assignment, bool ignore_state, int debugMode, int level);
 
-bool evaluateFormulaOnStateQuantified(formula_type type, var_declaration & qvariables, size_t done, int & instance_counter, general_formula * f, set<ground_literal> & state, map<string,string> & variable_assignment, bool ignore_state, int debugMode, int level){
+bool evaluateFormulaOnStateQuantified(formula_type type, const var_declaration & qvariables, size_t done, int & instance_counter, general_formula * f, set<ground_literal> & state, map<string,string> & variable_assignment, bool ignore_state, int debugMode, int level){
 
 	// if we have assigned all variables evaluate the sub expression
 	if (qvariables.vars.size() == done){
@@ -174,8 +174,8 @@ bool evaluateFormulaOnState(general_formula * f, set<ground_literal> & state, ma
 		return true;
 	}
 	if (f->type == EQUAL || f->type == NOTEQUAL) {
-		string a = get_const(f->arg1,variable_assignment);
-		string b = get_const(f->arg2,variable_assignment);
+		string a = get_const(f->arg1(),variable_assignment);
+		string b = get_const(f->arg2(),variable_assignment);
 		
 		bool result = (a == b) == (f->type == EQUAL);
 
@@ -192,8 +192,8 @@ bool evaluateFormulaOnState(general_formula * f, set<ground_literal> & state, ma
 		return result;
 	}
 	if (f->type == OFSORT || f->type == NOTOFSORT) {
-		string a = get_const(f->arg1,variable_assignment);
-		string sortname = f->arg2;
+		string a = get_const(f->arg1(),variable_assignment);
+		string sortname = f->arg2();
 		
 		bool result = sorts[sortname].count(a) == (f->type == OFSORT);
 		
@@ -266,15 +266,15 @@ bool evaluateFormulaOnState(general_formula * f, set<ground_literal> & state, ma
 			else                 cout << color(COLOR_PURPLE,"NOTATOM") << endl;
 			print_n_spaces(1+2*level+1);
 			cout << "atom: " << f->predicate;
-			for (string v : f->arguments.vars) cout << " " << v;
+			for (string v : f->arguments().vars) cout << " " << v;
 			cout << endl;
 		}
 
 		ground_literal atom;
 		atom.positive = true; // even for not atom, because the state is CWA
 		atom.predicate = f->predicate;
-		for (string v : f->arguments.vars){
-			string value = get_const(v,variable_assignment, f->arguments.newVar);
+		for (string v : f->arguments().vars){
+			string value = get_const(v,variable_assignment, f->arguments().newVar);
 			if (debugMode == 2){
 				print_n_spaces(1+2*level+1);
 				cout << "Variable " << v << " evaluates to " << value << endl;
@@ -304,7 +304,7 @@ bool evaluateFormulaOnState(general_formula * f, set<ground_literal> & state, ma
 		}
 		
 		int instance_counter = 0;
-		return evaluateFormulaOnStateQuantified(f->type, f->qvariables, 0, instance_counter, f->subformulae[0], state, variable_assignment, ignore_state, debugMode, level+1);
+		return evaluateFormulaOnStateQuantified(f->type, f->qvariables(), 0, instance_counter, f->subformulae[0], state, variable_assignment, ignore_state, debugMode, level+1);
 	}
 
 	// things that are not allowed in preconditions
@@ -393,8 +393,8 @@ void executeFormulaOnState(general_formula * f, set<ground_literal> & old_state,
 		ground_literal atom;
 		atom.positive = true; // even for not atom, because the state is CWA
 		atom.predicate = f->predicate;
-		for (string v : f->arguments.vars)
-			atom.args.push_back(get_const(v,variable_assignment, f->arguments.newVar));
+		for (string v : f->arguments().vars)
+			atom.args.push_back(get_const(v,variable_assignment, f->arguments().newVar));
 
 		if (f->type == ATOM) add.insert(atom);
 		else del.insert(atom);
@@ -412,7 +412,7 @@ void executeFormulaOnState(general_formula * f, set<ground_literal> & old_state,
 		// compute all instantiations of the quantified variables
 		vector<map<string,string> > var_replace;
 		var_replace.push_back(variable_assignment);
-		for(pair<string,string> var : f->qvariables.vars) {
+		for(pair<string,string> var : f->qvariables().vars) {
 			vector<map<string,string> > old_var_replace = var_replace;
 			var_replace.clear();
 
@@ -967,6 +967,8 @@ pair<pair<bool,bool>,vector<pair<int,int>>> findLinearisation(int currentTask,
 		map<int,vector<pair<map<string,int>,map<string,string>>>> & matchings,
 		map<int,int> & pos_in_primitive_plan,
 		vector<int> & primitive_plan,
+		// the initial state, built once by the caller
+		const set<ground_literal> & init_state,
 		// task instantiation
 		map<int,map<string,string>> & task_variable_values,
 		map<int,parsed_task> & taskIDToParsedTask,
@@ -1065,7 +1067,7 @@ pair<pair<bool,bool>,vector<pair<int,int>>> findLinearisation(int currentTask,
 		bool subtasksOk = true;
 		vector<pair<int,int>> recursiveEdges;
 		for (int st : subtasksForTask[currentTask]){
-			pair<pair<bool,bool>,vector<pair<int,int>>> linearisation = findLinearisation(st,parsedMethodForTask,tasks,subtasksForTask,matchings,pos_in_primitive_plan,primitive_plan,task_variable_values,taskIDToParsedTask,chosen_method_matchings,chosen_non_unique_matchings,forbidden_matchings, backtrackForbidden, uniqueMatching,false,debugMode,level + (uniqueMatching?0:1));
+			pair<pair<bool,bool>,vector<pair<int,int>>> linearisation = findLinearisation(st,parsedMethodForTask,tasks,subtasksForTask,matchings,pos_in_primitive_plan,primitive_plan,init_state,task_variable_values,taskIDToParsedTask,chosen_method_matchings,chosen_non_unique_matchings,forbidden_matchings, backtrackForbidden, uniqueMatching,false,debugMode,level + (uniqueMatching?0:1));
 			// add all edges to result
 			recursiveEdges.insert(recursiveEdges.end(),linearisation.second.begin(), linearisation.second.end());
 			subtasksOk &= linearisation.first.first;
@@ -1129,8 +1131,8 @@ pair<pair<bool,bool>,vector<pair<int,int>>> findLinearisation(int currentTask,
 			}
 
 			// if this DAG cannot be executed, just continue ...
-			set<ground_literal> init_set;
-			init_set.insert(init.begin(), init.end());
+			// executeDAG consumes the state it is given, so it works on a copy
+			set<ground_literal> init_set = init_state;
 			if (debugMode){
 				print_n_spaces(1+2*level+1);
 				cout << "Running exponential top-sort." << endl;
@@ -1190,7 +1192,7 @@ pair<pair<bool,bool>,vector<pair<int,int>>> findLinearisation(int currentTask,
 					chosen_method_matchings.clear();
 				
 					backtrackForbidden = false;
-					return findLinearisation(currentTask,parsedMethodForTask,tasks,subtasksForTask,matchings,pos_in_primitive_plan,primitive_plan,task_variable_values,taskIDToParsedTask,chosen_method_matchings,chosen_non_unique_matchings,forbidden_matchings,backtrackForbidden, true,true,debugMode,0);
+					return findLinearisation(currentTask,parsedMethodForTask,tasks,subtasksForTask,matchings,pos_in_primitive_plan,primitive_plan,init_state,task_variable_values,taskIDToParsedTask,chosen_method_matchings,chosen_non_unique_matchings,forbidden_matchings,backtrackForbidden, true,true,debugMode,0);
 				}
 			}
 			if (debugMode){
@@ -1225,7 +1227,8 @@ pair<pair<bool,bool>,vector<pair<int,int>>> findLinearisation(int currentTask,
 
 bool check_executability_of_primitive_plan(parsed_plan & plan, map<int,parsed_task> taskIDToParsedTask, map<int,map<string,string>> taskVariableValues, int debugMode){
 	set<ground_literal> current_state;
-	current_state.insert(init.begin(), init.end());
+	vector<ground_literal> init_literals = init.literals();
+	current_state.insert(init_literals.begin(), init_literals.end());
 
 	for (int & primID : plan.primitive_plan){
 		parsed_task t = taskIDToParsedTask[primID];
@@ -1646,7 +1649,10 @@ bool verify_plan(istream & plan, bool useOrderInformation, bool lenientMode, int
 	if (debugMode){
 		cout << color(COLOR_YELLOW,"Check whether primitive plan is a linearisation of the orderings resulting from applied decomposition methods.", MODE_UNDERLINE) << endl;
 	}
-	pair<pair<bool,bool>,vector<pair<int,int>>> linearisation = findLinearisation(root_task,parsedMethodForTask,tasks,subtasksForTask,possibleMethodInstantiations,pos_in_primitive_plan,primitive_plan,taskVariableValues,taskIDToParsedTask,chosen_method_matchings,chosen_non_unique_matchings,forbidden_matchings,irrelevant,true,true,debugMode,0);
+	set<ground_literal> init_state;
+	vector<ground_literal> init_literals = init.literals();
+	init_state.insert(init_literals.begin(), init_literals.end());
+	pair<pair<bool,bool>,vector<pair<int,int>>> linearisation = findLinearisation(root_task,parsedMethodForTask,tasks,subtasksForTask,possibleMethodInstantiations,pos_in_primitive_plan,primitive_plan,init_state,taskVariableValues,taskIDToParsedTask,chosen_method_matchings,chosen_non_unique_matchings,forbidden_matchings,irrelevant,true,true,debugMode,0);
 	if (debugMode){
 		cout << "Result " << linearisation.first.first << " " << linearisation.first.second << endl;
 	}